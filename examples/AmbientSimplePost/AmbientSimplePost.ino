@@ -45,10 +45,13 @@ void setup()
   /* WiFi Module Initialize */
   Init_GS2200_SPI_type(iS110B_TypeC);
 
+  /* Settings already in the module profile are not sent again */
+  gs2200.set_boot_profile( true );
   if( gs2200.begin( gsparams ) ){
     Serial.println( "GS2200 Initilization Fails" );
     while(1);
   }
+  gs2200.print_boot_report();
 
   /* GS2200 Association to AP */
   if( gs2200.activate_station( apSsid, apPass ) ){
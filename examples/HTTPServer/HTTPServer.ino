@@ -16,6 +16,7 @@
 */
 
 #include <TelitWiFi.h>
+#include <GS2200Server.h>
 #include "config.h"
 
 
@@ -26,6 +27,7 @@ uint8_t Receive_Data[RECEIVE_PACKET_SIZE] = {0};
 
 TelitWiFi gs2200;
 TWIFI_Params gsparams;
+GS2200Server server(&gs2200, atoi(TCPSRVR_PORT));
 
 // Contents data creation
 String header         = " HTTP/1.1 200 OK \r\n";
@@ -71,48 +73,36 @@ void setup() {
     while(1);
   }
 
+  ConsoleLog("Start TCP Server");
+  server.begin();
+
   digitalWrite( LED0, HIGH ); // turn on LED
 
 }
 
 // the loop function runs over and over again forever
+// Several browsers can be connected at once, each request is answered in turn
 void loop() {
 
-  char remote_cid = 0;
-  char server_cid = 0;
-  uint32_t timer = 5000;
-  
-  ConsoleLog("Start TCP Server");
-  server_cid = gs2200.start_tcp_server((char*)TCPSRVR_PORT);
-  if (server_cid == ATCMD_INVALID_CID) {
-    delay(2000);
-    return;
+  GS2200Client client = server.accept();
+  if (client) {
+    ConsolePrintf("TCP Client Connected : CID %c\r\n", client.cid());
   }
 
-  while(1) {
-    ConsoleLog("Waiting for TCP Client");
-    if (true != gs2200.wait_connection(&remote_cid, timer)) {
-      continue;
-    }
-
-    ConsoleLog("TCP Client Connected");
-    sleep(1);
-
-    // Start the echo server
-    while (gs2200.available()) {
-      WiFi_InitESCBuffer();
-      if (0 < gs2200.read(remote_cid, Receive_Data, RECEIVE_PACKET_SIZE)) {
-          ConsolePrintf("Received : %s\r\n", Receive_Data);
-          String message = (char*)Receive_Data;
-          if (message.substring(0, message.indexOf(' ')) == "GET") {
-            int length = send_contents(Receive_Data, RECEIVE_PACKET_SIZE);
-            ConsolePrintf("Will send : %s\r\n", Receive_Data);
-            if (true != gs2200.write(remote_cid, Receive_Data, length)) {
-              // Data is not sent, we need to re-send the data
-              delay(10);
-              ConsolePrintf("Sent Error : %s\r\n", Receive_Data);
-            }
-          }
+  client = server.available();
+  if (client) {
+    int length = client.read(Receive_Data, RECEIVE_PACKET_SIZE - 1);
+    if (0 < length) {
+      Receive_Data[length] = '\0';
+      ConsolePrintf("Received : %s\r\n", Receive_Data);
+      String message = (char*)Receive_Data;
+      if (message.substring(0, message.indexOf(' ')) == "GET") {
+        length = send_contents(Receive_Data, RECEIVE_PACKET_SIZE);
+        ConsolePrintf("Will send : %s\r\n", Receive_Data);
+        if (client.write(Receive_Data, length) != (size_t)length) {
+          ConsolePrintf("Sent Error : %s\r\n", Receive_Data);
+        }
+        client.flush();
       }
     }
   }
@@ -0,0 +1,129 @@
+/*
+ *  HttpBenchmark.ino - GainSpan WiFi Module Control Program
+ *  Copyright 2026 Spresense Users
+ *
+ *  This work is free software; you can redistribute it and/or modify it under the terms 
+ *  of the GNU Lesser General Public License as published by the Free Software Foundation; 
+ *  either version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This work is distributed in the hope that it will be useful, but without any warranty; 
+ *  without even the implied warranty of merchantability or fitness for a particular 
+ *  purpose. See the GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License along with 
+ *  this work; if not, write to the Free Software Foundation, 
+ *  Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#include <HttpGs2200.h>
+#include <HttpTcpGs2200.h>
+#include <TelitWiFi.h>
+#include "config.h"
+
+
+#define  CONSOLE_BAUDRATE  115200
+
+TelitWiFi gs2200;
+TWIFI_Params gsparams;
+HttpGs2200 theHttpGs2200(&gs2200);
+HttpTcpGs2200 theHttpTcp(&gs2200);
+HTTPGS2200_HostParams hostParams;
+
+/* Only the status code is counted, the bodies are parsed and dropped */
+const HTTPPARSER_Callbacks parse_only = { NULL, NULL, NULL };
+
+
+void report(const char* name, int ok, uint32_t elapsed)
+{
+	ConsolePrintf("%s: %d/%d requests in %d ms, %d.%02d requests/s\r\n",
+	              name, ok, BENCH_REQUESTS, elapsed,
+	              elapsed ? ok * 1000 / elapsed : 0,
+	              elapsed ? (ok * 100000 / elapsed) % 100 : 0);
+}
+
+/* AT+HTTPSEND, one request at a time on a keep-alive connection */
+void bench_at()
+{
+	uint32_t start = millis();
+	int ok = 0;
+
+	for (int i = 0; i < BENCH_REQUESTS; i++) {
+		if (theHttpGs2200.get(HTTP_GET_PATH) && theHttpGs2200.wait_response() == 200) {
+			ok++;
+		}
+		theHttpGs2200.end();
+	}
+
+	report("AT+HTTPSEND", ok, msDelta(start));
+}
+
+/* Raw TCP, up to HTTPTCP_PIPELINE_MAX requests in flight */
+void bench_tcp()
+{
+	uint32_t start = millis();
+	int sent = 0;
+	int ok = 0;
+
+	while (sent < BENCH_REQUESTS || theHttpTcp.pending()) {
+		while (sent < BENCH_REQUESTS && theHttpTcp.pending() < HTTPTCP_PIPELINE_MAX) {
+			if (!theHttpTcp.get(HTTP_GET_PATH)) {
+				break;
+			}
+			sent++;
+		}
+		if (!theHttpTcp.pending()) {
+			break;   /* cannot connect */
+		}
+		if (theHttpTcp.wait_response() == 200) {
+			ok++;
+		}
+	}
+
+	report("TCP pipelined", ok, msDelta(start));
+}
+
+void setup() {
+
+	/* initialize digital pin LED_BUILTIN as an output. */
+	pinMode(LED0, OUTPUT);
+	digitalWrite( LED0, LOW );   // turn the LED off (LOW is the voltage level)
+	Serial.begin( CONSOLE_BAUDRATE ); // talk to PC
+
+	/* Initialize SPI access of GS2200 */
+	Init_GS2200_SPI_type(iS110B_TypeC);
+
+	/* Initialize AT Command Library Buffer */
+	gsparams.mode = ATCMD_MODE_STATION;
+	gsparams.psave = ATCMD_PSAVE_DEFAULT;
+	if (gs2200.begin(gsparams)) {
+		ConsoleLog( "GS2200 Initilization Fails" );
+		while(1);
+	}
+
+	/* GS2200 Association to AP */
+	if( gs2200.activate_station( AP_SSID, PASSPHRASE ) ){
+		ConsoleLog( "Association Fails" );
+		while(1);
+	}
+
+	hostParams.host = (char *)HTTP_SRVR_IP;
+	hostParams.port = (char *)HTTP_PORT;
+	theHttpGs2200.begin(&hostParams);
+	theHttpGs2200.config(HTTP_HEADER_HOST, HTTP_SRVR_IP);
+	theHttpGs2200.set_keepalive(true);
+	theHttpGs2200.set_response_callbacks(&parse_only, NULL);
+
+	theHttpTcp.begin(HTTP_SRVR_IP, HTTP_PORT);
+
+	digitalWrite( LED0, HIGH ); // turn on LED
+}
+
+void loop() {
+	bench_at();
+	theHttpGs2200.close_all();
+
+	bench_tcp();
+	theHttpTcp.end();
+
+	sleep(5);
+}
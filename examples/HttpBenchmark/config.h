@@ -0,0 +1,32 @@
+/*
+ *  config.h - WiFi Configration Header
+ *
+ *  This work is free software; you can redistribute it and/or modify it under the terms 
+ *  of the GNU Lesser General Public License as published by the Free Software Foundation; 
+ *  either version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This work is distributed in the hope that it will be useful, but without any warranty; 
+ *  without even the implied warranty of merchantability or fitness for a particular 
+ *  purpose. See the GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License along with 
+ *  this work; if not, write to the Free Software Foundation, 
+ *  Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+/*-------------------------------------------------------------------------*
+ * Configration
+ *-------------------------------------------------------------------------*/
+#define  AP_SSID        "linksys"
+#define  PASSPHRASE     "0123456789"
+
+#define  HTTP_SRVR_IP  "192.168.1.100"
+#define  HTTP_PORT     "10080"
+#define  HTTP_GET_PATH "/"
+
+#define  BENCH_REQUESTS  50   /* requests per run */
+
+#endif /*_CONFIG_H_*/
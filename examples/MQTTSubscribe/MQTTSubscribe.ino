@@ -65,7 +65,18 @@ void setup() {
 char server_cid = 0;
 bool served = false;
 uint16_t len, count=0;
-MQTTGS2200_Mqtt mqtt;
+
+/* Called for each fragment of a message on MQTT_TOPIC */
+void onMessage(const char* topic, const uint8_t* data, uint16_t length, uint32_t offset, uint32_t total)
+{
+	if (offset == 0) {
+		ConsolePrintf("Recieve topic: %s (%d bytes)\n", topic, total);
+	}
+	Serial.write(data, length);
+	if (offset + length == total) {
+		Serial.println();
+	}
+}
 
 // the loop function runs over and over again forever
 void loop() {
@@ -82,10 +93,7 @@ void loop() {
 		WiFi_InitESCBuffer();
 
 		// Start the loop to receive the data
-		strncpy(mqtt.params.topic, MQTT_TOPIC , sizeof(mqtt.params.topic));
-		mqtt.params.QoS = 0;
-		mqtt.params.retain = 0;
-		if (true == theMqttGs2200.subscribe(&mqtt)) {
+		if (true == theMqttGs2200.subscribe(MQTT_TOPIC, onMessage)) {
 			ConsolePrintf( "Subscribed! \n" );
 		} 
 
@@ -95,15 +103,12 @@ void loop() {
 		uint64_t start = millis();
 		while (served) {
 			if (msDelta(start) < SUBSCRIBE_TIMEOUT ) {
-				String data;
 				/* just in case something from GS2200 */
-				while (gs2200.available()) {
-					if (false == theMqttGs2200.receive(data)) {
+				if (gs2200.available()) {
+					if (false == theMqttGs2200.poll()) {
 						served = false; // quite the loop
 						break;
 					}
-
-					Serial.println("Recieve data: " + data);
 				}
 				start = millis();
 			} else {
@@ -16,6 +16,7 @@
 */
 
 #include <TelitWiFi.h>
+#include <GS2200Task.h>
 #include "config.h"
 #include <Audio.h>
 #include <LowPower.h>
@@ -27,11 +28,10 @@
  *-------------------------------------------------------------------------*/
 AudioClass *theAudio;
 TelitWiFi gs2200;
+GS2200Task gs2200io(&gs2200);
 TWIFI_Params gsparams;
 char server_cid = 0;
 char TCP_Data[]=RADIO_SITE;
-const uint16_t TCP_RECEIVE_PACKET_SIZE = 1500;
-uint8_t TCP_Receive_Data[TCP_RECEIVE_PACKET_SIZE] = {0};
 
 enum State {
 	E_RadioStart,
@@ -113,6 +113,12 @@ void setup() {
 		while(1);
 	}
 	
+	/* From here the I/O task owns GS2200, the other tasks use its queues */
+	if (!gs2200io.begin()) {
+		ConsoleLog("I/O Task Fails");
+		while(1);
+	}
+
 	digitalWrite( LED0, LOW );  // turn off LED
 	digitalWrite( LED1, HIGH ); // turn on LED
 }
@@ -123,7 +129,7 @@ void setup() {
 void start_radio() {
 	do {
 		// Start a TCP client
-		server_cid = gs2200.connect(RADIO_IP, RADIO_PORT);
+		server_cid = gs2200io.connect(RADIO_IP, RADIO_PORT);
 	} while (server_cid == ATCMD_INVALID_CID);
 	digitalWrite( LED1, LOW );  // turn off LED
 	digitalWrite( LED2, HIGH ); // turn on LED
@@ -192,29 +198,29 @@ static int es_reader(int argc, FAR char *argv[])
 {
 	(void)argc;
 	(void)argv;
-	int receive_size = 0;
+	GS2200TASK_RxFrame *frame;
+	uint32_t ticket;
 
 	while (1) {
 		/*Wait for data.*/
-		for (int i= 200; gs2200.available() == 0; i--) {
+		for (int i= 200; (frame = gs2200io.receive(&ticket)) == NULL; i--) {
 			if (i==0) {
 			  LowPower.reboot();
 			}
 			usleep(10000);
 		}
-		
-		while (gs2200.available()) {
-			receive_size = gs2200.read(server_cid, TCP_Receive_Data, TCP_RECEIVE_PACKET_SIZE);
-			if (0 < receive_size) {
+
+		while (frame) {
+			if (frame->cid == server_cid && 0 < frame->length) {
 				switch (state) {
 				case E_RadioStart:
-					write_StartRadio(TCP_Receive_Data, receive_size);
+					write_StartRadio(frame->data, frame->length);
 					break;
 				case E_AudioStart:
-					write_StartAudio(TCP_Receive_Data, receive_size);
+					write_StartAudio(frame->data, frame->length);
 					break;
 				case E_Run:
-					write_Run(TCP_Receive_Data, receive_size);
+					write_Run(frame->data, frame->length);
 					break;
 				case E_Stop:
 					theAudio->stopPlayer(AudioClass::Player0,AS_STOPPLAYER_NORMAL);
@@ -226,8 +232,9 @@ static int es_reader(int argc, FAR char *argv[])
 					puts("error!");
 					exit(1);
 				}
-				WiFi_InitESCBuffer();
 			}
+			gs2200io.done(ticket);
+			frame = gs2200io.receive(&ticket);
 		}
 	}
 }
@@ -237,12 +244,13 @@ static int es_reader(int argc, FAR char *argv[])
  */
 
 void loop() {
+	GS2200QUEUE_Stats tx, rx;
 
 	start_radio();
 
 	// Connect Net Radio server
 	while (1) {
-		if (true != gs2200.write(server_cid, (const uint8_t*)TCP_Data, strlen(TCP_Data))) {
+		if (strlen(TCP_Data) != gs2200io.write(server_cid, (const uint8_t*)TCP_Data, strlen(TCP_Data))) {
 			// Data is not sent, we need to re-send the data
 			delay(1);
 			continue;
@@ -254,6 +262,8 @@ void loop() {
 	task_create("es_reader", 155, 1024, es_reader, NULL);
 
 	while (1) {
-		sleep(10000);
+		sleep(10);
+		gs2200io.get_queue_stats(NULL, &tx, &rx);
+		ConsolePrintf("RX queue: %d frames, peak %d, %d bytes dropped, TX queue: peak %d\r\n", rx.popped, rx.peak, rx.dropped, tx.peak);
 	}
 }
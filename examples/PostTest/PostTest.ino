@@ -29,21 +29,18 @@ TWIFI_Params gsparams;
 HttpGs2200 theHttpGs2200(&gs2200);
 HTTPGS2200_HostParams hostParams;
 
-const uint16_t RECEIVE_PACKET_SIZE = 1500;
-uint8_t Receive_Data[RECEIVE_PACKET_SIZE] = {0};
 bool result = false;
 int size;
 char size_string[10];
 
-void parse_httpresponse(char *message)
+/* The response body is printed while it is received */
+void on_body(const uint8_t* data, uint16_t length, void* arg)
 {
-	char *p;
-	
-	if( (p=strstr( message, "200 OK\r\n" )) != NULL ){
-		ConsolePrintf( "Response : %s\r\n", p+8 );
-	}
+	Serial.write(data, length);
 }
 
+const HTTPPARSER_Callbacks callbacks = { NULL, NULL, on_body };
+
 
 void setup() {
 
@@ -80,8 +77,8 @@ void setup() {
   theHttpGs2200.config(HTTP_HEADER_CONTENT_TYPE, "application/x-www-form-urlencoded");
   theHttpGs2200.config(HTTP_HEADER_HOST, HTTP_SRVR_IP);
 
-  /* Prepare for the next chunck of incoming data */
-  WiFi_InitESCBuffer();
+  /* Parse the responses while they are received */
+  theHttpGs2200.set_response_callbacks(&callbacks, NULL);
 
   size = SEND_SIZE;
   memset( sendData, '0', SEND_SIZE );
@@ -100,14 +97,7 @@ void loop() {
   result = theHttpGs2200.post(HTTP_POST_PATH, sendData);
 
   /* Need to receive the HTTP response */
-  if (0 < theHttpGs2200.receive(Receive_Data, RECEIVE_PACKET_SIZE)) {
-      parse_httpresponse( (char *)(Receive_Data) );
-  } else {
-    printf("theHttpGs2200.receive err.\n");
-  }
-
-  /* Need to receive the HTTP response */
-  /* Timeout for 2000ms*/
-  result = theHttpGs2200.receive(2000);
+  /* Timeout for 10000ms*/
+  ConsolePrintf("\r\nStatus : %d\r\n", theHttpGs2200.wait_response(10000));
   result = theHttpGs2200.end();
 }
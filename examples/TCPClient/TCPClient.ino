@@ -91,6 +91,16 @@ static void led_effect(void)
 		
 }
 
+/*---------------------------------------------------------------------------*
+ * on_reopen
+ *---------------------------------------------------------------------------*
+ * Description: The link supervisor opened the connection again
+ *---------------------------------------------------------------------------*/
+static void on_reopen(char oldCid, char newCid, void *arg)
+{
+	*(char *)arg = newCid;
+}
+
 // the setup function runs once when you press reset or power the board
 void setup() {
 	/* initialize digital pin of LEDs as an output. */
@@ -138,6 +148,10 @@ void loop() {
 				continue;
 			}
 			served = true;
+
+			// Reassociate and reconnect if the AP goes away
+			gs2200.set_supervisor(true, on_reopen, &server_cid);
+			gs2200.supervise_socket(server_cid, TWIFI_TCP_CLIENT, TCPSRVR_IP, TCPSRVR_PORT);
 		}
 		else {
 			ConsoleLog("Start to send TCP Data");
@@ -146,6 +160,10 @@ void loop() {
 
 			// Start the infinite loop to send the data
 			while (1) {
+				if (TWIFI_LINK_UP != gs2200.supervise() || server_cid == ATCMD_INVALID_CID) {
+					delay(10);
+					continue;
+				}
 				if (false == gs2200.write(server_cid, TCP_Data, strlen((const char*)TCP_Data))) {
 					// Data is not sent, we need to re-send the data
 					delay(10);
@@ -16,6 +16,7 @@
 */
 
 #include <TelitWiFi.h>
+#include <GS2200Server.h>
 #include "config.h"
 
 #include <Camera.h>
@@ -26,6 +27,7 @@ uint8_t Receive_Data[RECEIVE_PACKET_SIZE] = {0};
 
 TelitWiFi gs2200;
 TWIFI_Params gsparams;
+GS2200Server server(&gs2200, atoi(TCPSRVR_PORT));
 
 
 /****************************************************************************
@@ -120,104 +122,73 @@ void setup()
 
   Serial.println("Setup Camera done.");
 
+  ConsoleLog( "Start TCP Server");
+  server.begin();
+
   ledOn(LED0);
 }
 
 /****************************************************************************
- * setup
+ * loop
+ * Every operator connected gets a picture on each request, in turn
  ****************************************************************************/
 void loop() {
 
-  char remote_cid = 0;
-  char server_cid = 0;
-  uint32_t timer = 5000;
+  unsigned long cam_before, cam_after, one_before, one_after;
 
-  ConsoleLog( "Start TCP Server");
+  GS2200Client client = server.accept();
+  if (client) {
+    ConsolePrintf( "TCP Client Connected: CID %c, %d clients\n", client.cid(), server.clients() );
+  }
 
-  server_cid = gs2200.start_tcp_server((char*)TCPSRVR_PORT);
-  if (server_cid == ATCMD_INVALID_CID) {
-    delay(2000);
+  client = server.available();
+  if (!client) {
     return;
   }
 
-  while (1) {
-    ConsoleLog( "Waiting for TCP Client");
-    if (true != gs2200.wait_connection(&remote_cid, timer)) {
-      continue;
-    }
-
-    ConsoleLog( "TCP Client Connected");
-    // Prepare for the next chunck of incoming data
-    WiFi_InitESCBuffer();
-    sleep(1);
-    
-    unsigned long cam_before, cam_after, one_before, one_after;
-    while (gs2200.available()) {
-      if (0 < gs2200.read(remote_cid, Receive_Data, RECEIVE_PACKET_SIZE)) {
-        String message = (char*)Receive_Data;
-
-        int space1_pos = message.indexOf(' ');
-        int space2_pos = message.indexOf(' ', space1_pos + 1);
-        String method  = message.substring(0, space1_pos);
-        String path    = message.substring(space1_pos + 1, space2_pos);
-        //ConsolePrintf( "get method: %s\r\n", method.c_str() );
-        //ConsolePrintf( "get path  : %s\r\n", path.c_str() );
-
-        if (method == "GET" && path == "/cam.jpg") {
-          one_before = millis();
-
-          cam_before = millis();
-          CamImage img = theCamera.takePicture();
-          cam_after = millis();
-          ConsolePrintf( "Take Cam:%dms\n", cam_after - cam_before );
-
-          if(img.getImgSize() != 0) {
-            //Serial.print("picture is available:");
-            //Serial.println(String(img.getImgSize()).c_str());
-
-            String response = "HTTP/1.1 200 OK\r\n"
-                              "Content-Type: image/jpeg\r\n"
-                              "Content-Length: " + String(img.getImgSize()) + "\r\n"
-                              "\r\n";
-
-            gs2200.write(remote_cid, (const uint8_t*)response.c_str(), response.length());
-
-            size_t sent_size = 0;
-            for (sent_size = 0; sent_size < img.getImgSize();) {
-              size_t send_size = min(img.getImgSize() - sent_size, MAX_RECEIVED_DATA - 100);
-              bool result = false;
-              do {
-                result = gs2200.write(remote_cid, (uint8_t *)(img.getImgBuff() + sent_size), send_size);
-                if (true == result) {
-                  sent_size += send_size;
-                } else {
-                  ConsolePrintf("Send Bulk Error, retry...\n");
-                  delay(100);
-                }
-              } while (true != result);
-
-              delay(30);
-            }
-            one_after = millis();
-            ConsolePrintf( "Send:%dms\n", one_after - one_before );
-
-          } else {
-            String response = "HTTP/1.1 404 Not Found";
-            if (true != gs2200.write(remote_cid, (const uint8_t*)response.c_str(), response.length())) {
-              delay(2000);
-              return;
-            }
-          }
-        } else {
-          // send HTTP Response
-          String response = "HTTP/1.1 404 Not Found";
-          if (true != gs2200.write(remote_cid, (const uint8_t*)response.c_str(), response.length())) {
-            delay(2000);
-            return;
-          }
-        }
-        WiFi_InitESCBuffer();
+  int length = client.read(Receive_Data, RECEIVE_PACKET_SIZE - 1);
+  if (length <= 0) {
+    return;
+  }
+  Receive_Data[length] = '\0';
+
+  String message = (char*)Receive_Data;
+
+  int space1_pos = message.indexOf(' ');
+  int space2_pos = message.indexOf(' ', space1_pos + 1);
+  String method  = message.substring(0, space1_pos);
+  String path    = message.substring(space1_pos + 1, space2_pos);
+  //ConsolePrintf( "get method: %s\r\n", method.c_str() );
+  //ConsolePrintf( "get path  : %s\r\n", path.c_str() );
+
+  if (method == "GET" && path == "/cam.jpg") {
+    one_before = millis();
+
+    cam_before = millis();
+    CamImage img = theCamera.takePicture();
+    cam_after = millis();
+    ConsolePrintf( "Take Cam:%dms\n", cam_after - cam_before );
+
+    if(img.getImgSize() != 0) {
+      String response = "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: image/jpeg\r\n"
+                        "Content-Length: " + String(img.getImgSize()) + "\r\n"
+                        "\r\n";
+
+      // The header goes out in the first frame of the picture
+      client.print(response);
+      if (client.write((const uint8_t *)img.getImgBuff(), img.getImgSize()) != img.getImgSize()) {
+        ConsolePrintf("Send Bulk Error\n");
       }
+      client.flush();
+
+      one_after = millis();
+      ConsolePrintf( "Send:%dms\n", one_after - one_before );
+      return;
     }
   }
+
+  // send HTTP Response
+  client.print("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+  client.flush();
 }
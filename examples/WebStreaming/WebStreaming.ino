@@ -149,6 +149,8 @@ void loop() {
     }
 
     ConsoleLog( "TCP Client Connected");
+    // Boundary lines are sent together with the start of the next image
+    gs2200.set_coalesce(remote_cid, true);
     sleep(1);
     unsigned long cam_before, cam_after, one_before, one_after;
     while (gs2200.available()) {
@@ -187,21 +189,18 @@ void loop() {
                         "\r\n";
 
               gs2200.write(remote_cid, (const uint8_t*)response.c_str(), response.length());
-              size_t sent_size = 0;
-              for (sent_size = 0; sent_size < img.getImgSize();) {
-                size_t send_size = min(img.getImgSize() - sent_size, MAX_RECEIVED_DATA - 100);
-                bool result = false;
-                do {
-                  result = gs2200.write(remote_cid, (uint8_t *)(img.getImgBuff() + sent_size), send_size);
-                  if (true == result) {
-                    sent_size += send_size;
-                  } else {
-                    ConsolePrintf("Send Bulk Error, retry...\n");
-                    delay(100);
-                  }
-                } while (true != result);
-                delay(30);
+              TWIFI_TxStats stats;
+              if (gs2200.write_stream(remote_cid, (const uint8_t *)img.getImgBuff(), img.getImgSize()) != img.getImgSize()) {
+                ConsolePrintf("Send Bulk Error\n");
               }
+              gs2200.get_tx_stats(&stats);
+              ConsolePrintf( "Stream:%d bytes/s\n", stats.throughput );
+              TWIFI_CoalesceStats cstats;
+              gs2200.get_coalesce_stats(&cstats);
+              ConsolePrintf( "Frames saved:%d\n", cstats.saved );
+              TWIFI_FlowStats fstats;
+              gs2200.get_flow_stats(remote_cid, &fstats);
+              ConsolePrintf( "Stalls:%d, %dms, longest %dms\n", fstats.stalls, fstats.stallTime, fstats.maxStall );
 
               one_after = millis();
               ConsolePrintf( "Send:%dms\n", one_after - one_before );
@@ -228,6 +227,7 @@ void loop() {
             delay(2000);
             return;
           }
+          gs2200.flush(remote_cid);
         }
         WiFi_InitESCBuffer();
       }
@@ -18,6 +18,7 @@
  */
 
 #include "AmbientGs2200.h"
+#include <sys/time.h>
 
 #define AMBIENT_DEBUG
 
@@ -32,6 +33,8 @@
 const char  path[] = "/api/v2/channels/";
 const char* ambient_keys[] = {"\"d1\":\"", "\"d2\":\"", "\"d3\":\"", "\"d4\":\"", "\"d5\":\"", "\"d6\":\"", "\"d7\":\"", "\"d8\":\"", "\"lat\":\"", "\"lng\":\"", "\"created\":\""};
 
+#define AMBIENT_CLOCK_VALID 1577836800  /* 2020-01-01, an earlier clock was never set */
+
 const char  server[] = "54.65.206.59";
 const char  port[] = "80";
 
@@ -108,10 +111,6 @@ bool AmbientGs2200::clear(int field)
 
 bool AmbientGs2200::send()
 {
-  // Prepare for the next chunck of incoming data
-
-  mCid = mWifi->connect( server, port );
-
   /* Retrieve the file with the specified URL. */
   String post = "{\"writeKey\":\"" + mWriteKey + "\",";
 
@@ -124,45 +123,127 @@ bool AmbientGs2200::send()
   }
   post.setCharAt(post.length()-1,'}'); // to overwrite the last conmma 
 
+  if (!mQueue) {
+    return this->post(post.c_str(), post.length(), true);
+  }
+
+  /* Older data goes first */
+  if (!mQueue->empty()) {
+    flush();
+  }
+
+  if (mQueue->empty() && this->post(post.c_str(), post.length(), true)) {
+    return true;
+  }
+
+  /* Sent later, keep the time of the sample unless "created" was set (UNIX time in ms) */
+  struct timeval now;
+  char created[32];
+
+  gettimeofday(&now, NULL);
+  if (!mData[AMBIENT_NUM_PARAMS - 1].set && now.tv_sec >= AMBIENT_CLOCK_VALID) {
+    snprintf(created, sizeof(created), "\"created\":%lu%03lu}",
+             (unsigned long)now.tv_sec, (unsigned long)(now.tv_usec / 1000));
+    post.setCharAt(post.length() - 1, ',');
+    post += created;
+  }
+
+  return (0 != mQueue->push(NULL, post.c_str(), post.length()));
+}
+
+/*
+ * Send the queued data while the server accepts it
+ */
+uint32_t AmbientGs2200::flush()
+{
+  if (!mQueue) {
+    return 0;
+  }
+
+  return mQueue->drain(send_queued, this);
+}
+
+bool AmbientGs2200::send_queued(const OFFLINEQUEUE_Record* rec, const char* key, const uint8_t* data, void* arg)
+{
+  AmbientGs2200* self = (AmbientGs2200*)arg;
+
+  (void)key;
+
+  /* The next record follows at once, no need to wait for the answer */
+  return self->post((const char*)data, rec->dataLen, false);
+}
+
+typedef struct {
+  uint8_t* buf;
+  uint16_t len;
+} DeflateOut;
+
+static bool deflate_sink(const uint8_t* data, uint16_t length, void* arg)
+{
+  DeflateOut* out = (DeflateOut*)arg;
+
+  if (out->len + length > ATCMD_BULK_MAX_SIZE) {
+    return false;
+  }
+  memcpy(out->buf + out->len, data, length);
+  out->len += length;
+  return true;
+}
+
+bool AmbientGs2200::post(const char* body, uint16_t length, bool linger)
+{
+  static uint8_t zbuf[ATCMD_BULK_MAX_SIZE];
+  DeflateOut out = { zbuf, 0 };
+  String encoding = String("");
+  bool sent;
+
+  // The body is sent in one frame, compressed only if it gets smaller enough
+
+  if (mDeflate && mDeflate->prepare(body, length) &&
+      mDeflate->write(body, length, deflate_sink, &out)) {
+    encoding = String("Content-Encoding: ") + mDeflate->encoding() + "\r\n";
+    body = (const char*)zbuf;
+    length = out.len;
+  }
+
+  // Prepare for the next chunck of incoming data
+
+  mCid = mWifi->connect( server, port );
+  if (mCid == ATCMD_INVALID_CID) {
+    ERR("Ambient: connect failed\n");
+    return false;
+  }
+
   String ctype = String("");
 
   String fullpath = path + String(this->mChannelId) + "/data";
 
 
   String data = "POST " + fullpath + " HTTP/1.1\r\nHOST: " + server + "\r\n";
-  data = data + "Content-Length: " + String( post.length()) + "\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n";
+  data = data + "Content-Length: " + String(length) + "\r\nContent-Type: application/json\r\n" + encoding + "Connection: close\r\n\r\n";
 //  data = data + "Content-Length: " + String( post.length()) + "\r\nContent-Type: application/json\r\n\r\n";
   
   Serial.println(data);
 
-  uint16_t length = data.length();
-  printf("cid=%c\tlengh=%d\n%s\n",mCid,length,data.c_str());
-  
-  while (1) {
-    if (true != mWifi->write(mCid, data.c_str(), length)) {
-      delay(1);
-    } else {
-      break;
-    }
-  }
+  printf("cid=%c\tlengh=%d\n%s\n",mCid,data.length(),data.c_str());
 
-  delay(100);
+  // Header and body are collected and sent in one frame, the flush waits
+  // for room in GS2200 so there is nothing to retry here
 
-  data = post;
-  length = data.length();
+  mWifi->set_coalesce(mCid, true);
 
-  while (1) {
-    if (true != mWifi->write(mCid, data.c_str(), length)) {
-      delay(1);
-    } else {
-      break;
-    }
+  sent = mWifi->write(mCid, data.c_str(), data.length()) &&
+         mWifi->write(mCid, body, length) &&
+         mWifi->flush(mCid);
+
+  if (linger) {
+    sleep(2);
   }
 
-  sleep(2);
+  // Connection: close, nothing is read back, so there is nothing to wait for
 
-  mWifi->stop(mCid);
+  mWifi->close(mCid);
   mCid = ATCMD_INVALID_CID;
 
-  return true;
+  return sent;
 }
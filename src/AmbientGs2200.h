@@ -24,6 +24,8 @@
 #include <GS2200Hal.h>
 #include <GS2200AtCmd.h>
 #include <TelitWiFi.h>
+#include <OfflineQueueGs2200.h>
+#include <DeflateGs2200.h>
 
 #define AMBIENT_WRITEKEY_SIZE 18
 #define AMBIENT_MAX_RETRY 5
@@ -35,7 +37,7 @@ class AmbientGs2200
 {
 public:
 
-  AmbientGs2200(TelitWiFi* wifi) : mWifi(wifi) {}
+  AmbientGs2200(TelitWiFi* wifi) : mWifi(wifi), mQueue(NULL), mDeflate(NULL) {}
   ~AmbientGs2200(){}
 
   bool begin(uint32_t channelId, const String& writeKey);
@@ -47,10 +49,22 @@ public:
   bool send();
   void end(){ }
 
+  /* Store-and-forward: data that cannot be sent is queued and sent later in order */
+  void set_offline_queue(OfflineQueueGs2200* queue) { mQueue = queue; }
+  uint32_t flush();
+
+  /* Compress the JSON body when it pays off */
+  void set_compression(DeflateGs2200* deflate) { mDeflate = deflate; }
+
 private:
 
+  bool post(const char* body, uint16_t length, bool linger);
+  static bool send_queued(const OFFLINEQUEUE_Record* rec, const char* key, const uint8_t* data, void* arg);
+
   TelitWiFi* mWifi;
   char mCid;
+  OfflineQueueGs2200* mQueue;
+  DeflateGs2200* mDeflate;
 
   uint32_t mChannelId;
   String mWriteKey;
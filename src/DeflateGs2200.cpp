@@ -0,0 +1,281 @@
+/*
+ *  Deflate Compressor for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "DeflateGs2200.h"
+
+#define NO_POS      0xFFFFFFFF
+#define MIN_MATCH   3
+#define MAX_MATCH   258
+
+/* RFC 1951 3.2.5 */
+static const uint16_t LengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DistBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+/* CRC-32 of gzip, 4 bits at a time */
+static const uint32_t CrcTable[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t crc32(const uint8_t* data, uint32_t length)
+{
+  uint32_t crc = 0xFFFFFFFF;
+
+  while (length--) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ CrcTable[crc & 0x0F];
+    crc = (crc >> 4) ^ CrcTable[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+static uint32_t adler32(const uint8_t* data, uint32_t length)
+{
+  uint32_t a = 1, b = 0;
+
+  while (length--) {
+    a = (a + *data++) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+static inline uint8_t hash3(const uint8_t* p)
+{
+  return (uint8_t)((p[0] << 4) ^ (p[1] << 2) ^ p[2] ^ (p[0] >> 4));
+}
+
+DeflateGs2200::DeflateGs2200(DEFLATE_Format format)
+  : mFormat(format), mEnabled(true), mBackoff(0)
+{
+  memset(&mStats, 0, sizeof(mStats));
+}
+
+uint32_t DeflateGs2200::prepare(const void* data, uint32_t length)
+{
+  uint32_t size;
+
+  mStats.bodies++;
+
+  if (!mEnabled || length < DEFLATE_MIN_SIZE || mBackoff) {
+    if (mBackoff) {
+      mBackoff--;
+    }
+    mStats.skipped++;
+    return 0;
+  }
+
+  size = run((const uint8_t*)data, length, NULL, NULL);
+  if ((uint64_t)size * 100 > (uint64_t)length * DEFLATE_MAX_RATIO) {
+    /* Not worth it, and the next bodies are likely alike */
+    mBackoff = DEFLATE_BACKOFF;
+    mStats.poor++;
+    return 0;
+  }
+
+  return size;
+}
+
+bool DeflateGs2200::write(const void* data, uint32_t length, DEFLATE_Sink sink, void* arg)
+{
+  uint32_t size = run((const uint8_t*)data, length, sink, arg);
+
+  if (!size) {
+    return false;
+  }
+
+  mStats.compressed++;
+  mStats.bytesIn += length;
+  mStats.bytesOut += size;
+  mStats.saved += (length > size) ? length - size : 0;
+  return true;
+}
+
+/*
+ * Greedy LZ77 with one candidate per hash, the result depends only on the
+ * input so both runs produce the same size. Returns 0 if the sink failed.
+ */
+uint32_t DeflateGs2200::run(const uint8_t* in, uint32_t length, DEFLATE_Sink sink, void* arg)
+{
+  static const uint8_t GzipHeader[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+  uint32_t pos = 0;
+  uint32_t cand, check;
+  uint16_t best, max, len;
+  uint8_t h;
+  int i;
+
+  mSink = sink;
+  mArg = arg;
+  mFailed = false;
+  mBits = 0;
+  mBitCount = 0;
+  mOutLen = 0;
+  mTotal = 0;
+
+  for (i = 0; i < DEFLATE_HASH_SIZE; i++) {
+    mHash[i] = NO_POS;
+  }
+
+  if (DEFLATE_GZIP == mFormat) {
+    for (i = 0; i < (int)sizeof(GzipHeader); i++) {
+      put_byte(GzipHeader[i]);
+    }
+  } else {
+    /* 32K window, fastest, no dictionary */
+    put_byte(0x78);
+    put_byte(0x01);
+  }
+
+  /* One final block with the fixed codes */
+  put_bits(1, 1);
+  put_bits(1, 2);
+
+  while (pos < length) {
+    best = 0;
+    if (pos + MIN_MATCH <= length) {
+      h = hash3(in + pos);
+      cand = mHash[h];
+      mHash[h] = pos;
+
+      if (cand != NO_POS && pos - cand <= DEFLATE_WINDOW) {
+        max = (length - pos < MAX_MATCH) ? length - pos : MAX_MATCH;
+        for (len = 0; len < max && in[cand + len] == in[pos + len]; len++);
+        if (len >= MIN_MATCH) {
+          best = len;
+        }
+      }
+    }
+
+    if (best) {
+      put_match(best, pos - cand);
+      for (len = 1; len < best; len++) {
+        if (pos + len + MIN_MATCH <= length) {
+          mHash[hash3(in + pos + len)] = pos + len;
+        }
+      }
+      pos += best;
+    } else {
+      put_symbol(in[pos]);
+      pos++;
+    }
+  }
+
+  /* End of block, then to a byte boundary */
+  put_symbol(256);
+  if (mBitCount) {
+    put_bits(0, 8 - mBitCount);
+  }
+
+  if (DEFLATE_GZIP == mFormat) {
+    check = sink ? crc32(in, length) : 0;
+    for (i = 0; i < 4; i++) {
+      put_byte(check >> (i * 8));
+    }
+    for (i = 0; i < 4; i++) {
+      put_byte(length >> (i * 8));
+    }
+  } else {
+    check = sink ? adler32(in, length) : 0;
+    for (i = 3; i >= 0; i--) {
+      put_byte(check >> (i * 8));
+    }
+  }
+
+  flush();
+  return mFailed ? 0 : mTotal;
+}
+
+void DeflateGs2200::put_symbol(uint16_t sym)
+{
+  if (sym < 144) {
+    put_huffman(0x30 + sym, 8);
+  } else if (sym < 256) {
+    put_huffman(0x190 + sym - 144, 9);
+  } else if (sym < 280) {
+    put_huffman(sym - 256, 7);
+  } else {
+    put_huffman(0xC0 + sym - 280, 8);
+  }
+}
+
+void DeflateGs2200::put_match(uint16_t length, uint16_t distance)
+{
+  int i;
+
+  for (i = 28; LengthBase[i] > length; i--);
+  put_symbol(257 + i);
+  put_bits(length - LengthBase[i], LengthExtra[i]);
+
+  for (i = 29; DistBase[i] > distance; i--);
+  put_huffman(i, 5);
+  put_bits(distance - DistBase[i], (i < 4) ? 0 : (i / 2 - 1));
+}
+
+/* Huffman codes are stored from the most significant bit */
+void DeflateGs2200::put_huffman(uint16_t code, uint8_t bits)
+{
+  uint16_t rev = 0;
+
+  for (uint8_t i = 0; i < bits; i++) {
+    rev = (rev << 1) | ((code >> i) & 1);
+  }
+  put_bits(rev, bits);
+}
+
+void DeflateGs2200::put_bits(uint32_t value, uint8_t bits)
+{
+  mBits |= value << mBitCount;
+  mBitCount += bits;
+  while (mBitCount >= 8) {
+    put_byte(mBits & 0xFF);
+    mBits >>= 8;
+    mBitCount -= 8;
+  }
+}
+
+void DeflateGs2200::put_byte(uint8_t c)
+{
+  mTotal++;
+  if (!mSink) {
+    return;
+  }
+
+  mOut[mOutLen++] = c;
+  if (mOutLen == DEFLATE_OUT_SIZE) {
+    flush();
+  }
+}
+
+void DeflateGs2200::flush()
+{
+  if (mSink && mOutLen && !mFailed) {
+    mFailed = !mSink(mOut, mOutLen, mArg);
+  }
+  mOutLen = 0;
+}
@@ -0,0 +1,99 @@
+/*
+ *  Deflate Compressor for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef DEFLATE_GS2200_h
+#define DEFLATE_GS2200_h
+
+#include <Arduino.h>
+
+#define DEFLATE_WINDOW     4096   /* farthest match distance */
+#define DEFLATE_HASH_SIZE   256   /* one candidate per hash, no chains */
+#define DEFLATE_OUT_SIZE    256   /* compressed bytes passed to the sink at a time */
+#define DEFLATE_MIN_SIZE     64   /* smaller bodies are sent as is */
+#define DEFLATE_MAX_RATIO    90   /* % of the original, a worse result is sent as is */
+#define DEFLATE_BACKOFF      16   /* bodies sent as is without trying after that */
+
+typedef enum {
+  DEFLATE_GZIP = 0,   /* Content-Encoding: gzip */
+  DEFLATE_ZLIB        /* Content-Encoding: deflate */
+} DEFLATE_Format;
+
+typedef struct {
+  uint32_t bodies;      /* bodies offered */
+  uint32_t compressed;  /* bodies sent compressed */
+  uint32_t poor;        /* bodies that did not compress well enough */
+  uint32_t skipped;     /* bodies not tried, too small, disabled or backing off */
+  uint32_t bytesIn;     /* original size of the compressed bodies */
+  uint32_t bytesOut;    /* their compressed size */
+  uint32_t saved;       /* bytesIn - bytesOut */
+} DEFLATE_Stats;
+
+/* Takes compressed data, returns false to abort */
+typedef bool (*DEFLATE_Sink)(const uint8_t* data, uint16_t length, void* arg);
+
+/*
+ * Single block deflate with the fixed Huffman codes, enough for JSON and
+ * other repetitive text. Matches are looked up in the body itself, so no
+ * window buffer is needed. prepare() runs the compressor without output to
+ * learn the size for Content-Length, write() runs it again to the sink.
+ */
+class DeflateGs2200
+{
+public:
+
+  DeflateGs2200(DEFLATE_Format format = DEFLATE_GZIP);
+  ~DeflateGs2200(){}
+
+  /* Compressed size, 0 if the body is to be sent as is */
+  uint32_t prepare(const void* data, uint32_t length);
+  bool write(const void* data, uint32_t length, DEFLATE_Sink sink, void* arg);
+
+  const char* encoding() { return (DEFLATE_GZIP == mFormat) ? "gzip" : "deflate"; }
+  void set_enable(bool enable) { mEnabled = enable; mBackoff = 0; }
+  void get_stats(DEFLATE_Stats* stats) { *stats = mStats; }
+  void reset_stats() { memset(&mStats, 0, sizeof(mStats)); }
+
+private:
+
+  uint32_t run(const uint8_t* in, uint32_t length, DEFLATE_Sink sink, void* arg);
+  void put_symbol(uint16_t sym);
+  void put_match(uint16_t length, uint16_t distance);
+  void put_huffman(uint16_t code, uint8_t bits);
+  void put_bits(uint32_t value, uint8_t bits);
+  void put_byte(uint8_t c);
+  void flush();
+
+  DEFLATE_Format mFormat;
+  bool mEnabled;
+  uint8_t mBackoff;
+  DEFLATE_Stats mStats;
+
+  uint32_t mHash[DEFLATE_HASH_SIZE];
+
+  DEFLATE_Sink mSink;
+  void* mArg;
+  bool mFailed;
+  uint32_t mBits;
+  uint8_t mBitCount;
+  uint8_t mOut[DEFLATE_OUT_SIZE];
+  uint16_t mOutLen;
+  uint32_t mTotal;
+};
+
+#endif // DEFLATE_GS2200_h
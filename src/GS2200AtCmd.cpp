@@ -32,6 +32,9 @@
 #define RXBUFFER_SIZE  1500
 
 #define NUM_OF_RESPBUFFER  32
+
+#define STREAM_RETRY_TIMEOUT  10000  /* give up a slice not accepted for this period */
+#define STREAM_RETRY_DELAY    10
 #define WS_MAXENTRIES      (NUM_OF_RESPBUFFER - 1)
 
 //#define ATCMD_DEBUG_ENABLE
@@ -50,6 +53,38 @@ uint8_t  RxBuffer[RXBUFFER_SIZE];
 uint8_t  *RespBuffer[NUM_OF_RESPBUFFER];
 int   RespBuffer_Index=0;
 
+/* Source address of the last <ESC>y frame, parsed from its header */
+static ATCMD_IPv4 UdpSrcAddr;
+static uint16_t   UdpSrcPort;
+
+/* Subscribed MQTT message being received, the payload is passed on in fragments */
+static ATCMD_MQTTHandler MqttHandler;
+static void    *MqttArg;
+static char     MqttCid;
+static char     MqttTopic[ATCMD_MQTT_TOPIC_MAX_SIZE + 1];
+static uint16_t MqttTopicLen;
+static bool     MqttTopicTruncated;   /* longer than ATCMD_MQTT_TOPIC_MAX_SIZE */
+static uint8_t  MqttFragment[ATCMD_MQTT_FRAGMENT_SIZE];
+static uint16_t MqttFragmentLen;
+static uint32_t MqttOffset;
+static uint32_t MqttTotal;
+
+/* HTTP response and TCP bulk data are passed on in fragments when a handler is set */
+/* Each handler is called with the arg registered along with it */
+static ATCMD_HTTPHandler HttpHandler;
+static void             *HttpArg;
+static ATCMD_BulkHandler BulkHandlers[ATCMD_MAX_CID];   /* per CID */
+static void             *BulkArgs[ATCMD_MAX_CID];
+static ATCMD_BulkHandler BulkDefault;                   /* CIDs without their own */
+static void             *BulkDefaultArg;
+static ATCMD_BulkHandler UdpHandler;
+static void             *UdpArg;
+static ATCMD_BulkHandler FrameHandler;   /* handler of the frame being received, NULL for ESCBuffer */
+static void             *FrameArg;
+static char     FrameCid;
+static uint8_t  Fragment[ATCMD_HTTP_FRAGMENT_SIZE];
+static uint16_t FragmentLen;
+
 
 
 /*-------------------------------------------------------------------------*
@@ -60,6 +95,10 @@ static ATCMD_SECURITYMODE_E ParseSecurityMode(const char *string);
 static void AtCmd_ParseIPAddress(const char *string, ATCMD_IP *ip);
 static uint8_t ParseIntoTokens(char *line, char deliminator, char *tokens[], uint8_t maxTokens);
 static char Search_CID( uint8_t *string );
+static ATCMD_RESP_E UDP_SendFrame(uint16_t headerLen, const void *txBuf, uint16_t dataLen);
+static ATCMD_RESP_E SendStreamData(const void *data, uint32_t size);
+static void MQTT_FlushFragment(void);
+static void FlushFragment(void);
 
 
 /*-------------------------------------------------------------------------*
@@ -206,6 +245,85 @@ static char Search_CID( uint8_t *string )
 
 }
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_CidIndex
+ *---------------------------------------------------------------------------*
+ * Description: '0'-'9', 'a'-'f' to 0-15, -1 if not a CID
+ *---------------------------------------------------------------------------*/
+int AtCmd_CidIndex( char cid )
+{
+	if( cid >= '0' && cid <= '9' )
+		return cid - '0';
+	if( cid >= 'a' && cid <= 'f' )
+		return cid - 'a' + 10;
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*
+ * MQTT_FlushFragment
+ *---------------------------------------------------------------------------*
+ * Description: Pass the received part of an MQTT message to the handler.
+ *              A message whose topic did not fit in MqttTopic is dropped,
+ *              its truncated topic could match another subscription.
+ *---------------------------------------------------------------------------*/
+static void MQTT_FlushFragment(void)
+{
+	if( MqttTopicTruncated ){
+		if( !MqttOffset )
+			ConsoleLog( "MQTT topic too long, message dropped" );
+	}
+	else if( MqttHandler )
+		MqttHandler( MqttCid, MqttTopic, MqttFragment, MqttFragmentLen, MqttOffset, MqttTotal, MqttArg );
+
+	MqttOffset += MqttFragmentLen;
+	MqttFragmentLen = 0;
+}
+
+/*---------------------------------------------------------------------------*
+ * FlushFragment
+ *---------------------------------------------------------------------------*
+ * Description: Pass the received part of a bulk frame to its handler
+ *---------------------------------------------------------------------------*/
+static void FlushFragment(void)
+{
+	if( FragmentLen )
+		FrameHandler( FrameCid, Fragment, FragmentLen, FrameArg );
+
+	FragmentLen = 0;
+}
+
+/*---------------------------------------------------------------------------*
+ * SendStreamData
+ *---------------------------------------------------------------------------*
+ * Description: Send the data part of an ESC sequence announced by a command.
+ *              Data is written in SPI_MAX_SIZE slices straight from the
+ *              caller buffer. A slice not accepted is sent again till timeout.
+ * Inputs: const void *data -- Data to send
+ *         uint32_t size -- Data size
+ *---------------------------------------------------------------------------*/
+static ATCMD_RESP_E SendStreamData(const void *data, uint32_t size)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	SPI_RESP_STATUS_E s;
+	uint16_t slice;
+	uint32_t start;
+
+	while( size ){
+		slice = ( size > SPI_MAX_SIZE ) ? SPI_MAX_SIZE : size;
+		start = millis();
+		while( SPI_RESP_STATUS_OK != ( s = WiFi_Write( p, slice ) ) ){
+			if( msDelta( start ) >= STREAM_RETRY_TIMEOUT )
+				return ATCMD_RESP_SPI_ERROR;
+			delay( STREAM_RETRY_DELAY );
+		}
+		p += slice;
+		size -= slice;
+	}
+
+	return ATCMD_RESP_OK;
+}
+
 
 
 /*
@@ -221,6 +339,12 @@ static char Search_CID( uint8_t *string )
 
  ATE<0|1>                                                                     Disable/enable echo
 
+ AT&W<0|1>                                                                    Save the configuration in a profile
+
+ AT&Y<0|1>                                                                    Profile loaded at boot
+
+ AT&V                                                                         Output the active and stored profiles
+
  AT+NMAC=?                                                                    Get MAC address
 
  AT+WRXACTIVE=<0|1>                                                           Enable/disable the radio
@@ -273,7 +397,7 @@ static char Search_CID( uint8_t *string )
 
  AT+NCLOSEALL                                                                 Close all connections
 
- AT+NXSETSOCKOPT                                                              Configure a socket
+ AT+NXSETSOCKOPT=<CID>,<Type>,<Param>,<Value>,<Length>                        Configure a socket
 
  AT+PSDPSLEEP                                                                 Enable deep sleep
 
@@ -341,6 +465,75 @@ ATCMD_RESP_E AtCmd_ATE(uint8_t n)
 	return AtCmd_SendCommand(cmd);
 }
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_ATW
+ *---------------------------------------------------------------------------*
+ * Description: Save the current configuration in a profile
+ * Inputs: uint8_t n -- profile 0 or 1
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_ATW(uint8_t n)
+{
+	char cmd[8];
+
+	sprintf(cmd, "AT&W%d\r\n", n);
+
+	return AtCmd_SendCommand(cmd);
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_ATY
+ *---------------------------------------------------------------------------*
+ * Description: Select the profile loaded at boot
+ * Inputs: uint8_t n -- profile 0 or 1
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_ATY(uint8_t n)
+{
+	char cmd[8];
+
+	sprintf(cmd, "AT&Y%d\r\n", n);
+
+	return AtCmd_SendCommand(cmd);
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_ATV
+ *---------------------------------------------------------------------------*
+ * Description: Get the active profile
+ * Inputs: char *active -- Settings of the active profile, each one
+ *                         between spaces such as " E0 +WM=0 +BDATA=1 "
+ *         uint16_t size -- Size of active
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_ATV(char *active, uint16_t size)
+{
+	ATCMD_RESP_E resp;
+	bool copy = false;
+	uint16_t len = 0;
+	int i;
+
+	active[0] = '\0';
+
+	resp = AtCmd_SendCommand( (char *)"AT&V\r\n");
+
+	if( resp == ATCMD_RESP_OK ){
+		for( i=0; i<RespBuffer_Index; i++ ){
+			if( strstr( (const char*)RespBuffer[i], "ACTIVE PROFILE" ) ){
+				copy = true;
+				continue;
+			}
+			if( strstr( (const char*)RespBuffer[i], "STORED PROFILE" ) )
+				break;
+			if( copy )
+				len += snprintf( active + len, ( len < size ) ? size - len : 0, " %s", RespBuffer[i] );
+		}
+		if( len + 1 < size ){
+			active[len++] = ' ';
+			active[len] = '\0';
+		}
+	}
+
+	return resp;
+}
+
 /*---------------------------------------------------------------------------*
  * Routine:  AtCmd_RESET
  *---------------------------------------------------------------------------*
@@ -896,6 +1089,29 @@ ATCMD_RESP_E AtCmd_NCLOSEALL(void)
 	return AtCmd_SendCommand( (char *)"AT+NCLOSEALL\r\n");
 }
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_NXSETSOCKOPT
+ *---------------------------------------------------------------------------*
+ * Description: Configure a socket option of the specified CID
+ *              AT+NXSETSOCKOPT=<cid>,<type>,<param>,<value>,<length>
+ * Inputs: uint8_t cid -- CID
+ *         ATCMD_SOCKET_OPTION_TYPE_E type -- option level (socket, IP, TCP)
+ *         ATCMD_SOCKET_OPTION_PARAM_E param -- option name
+ *         uint32_t value -- option value
+ *         uint8_t length -- length of the option value in bytes
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_NXSETSOCKOPT(uint8_t cid, ATCMD_SOCKET_OPTION_TYPE_E type, ATCMD_SOCKET_OPTION_PARAM_E param, uint32_t value, uint8_t length)
+{
+	char cmd[50];
+
+	if( ATCMD_INVALID_CID == cid )
+		return ATCMD_RESP_INVALID_CID;
+
+	sprintf(cmd, "AT+NXSETSOCKOPT=%c,%d,%d,%ld,%d\r\n", cid, type, param, value, length);
+
+	return AtCmd_SendCommand(cmd);
+}
+
 /*------------------------------------  Power Save Operations  ----------------------------------------*/
 
 /*---------------------------------------------------------------------------*
@@ -1100,8 +1316,12 @@ ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr)
 	
 	static uint8_t  getCid;
 	static bool  spcFlag, htabFlag;
+	static uint8_t ipIndex;
 	static uint16_t dataLen = 0;
 	static uint8_t dataLenCount = 0;
+	static uint8_t hdrCount;
+	static uint8_t escType;
+	int idx;
 	
 	ATCMD_RESP_E resp = ATCMD_RESP_UNMATCH;
 	
@@ -1185,14 +1405,20 @@ ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr)
 		break;
 		
 	case ATCMD_FSM_ESC_START:
+		escType = *ptr;
 		if ( 'Z' == *ptr) {
 			/* Bulk data handling start */
 			/* <Esc>Z<Cid><Data Length xxxx 4 ascii char><data>   */
+			FrameHandler = NULL;   /* decided on the CID */
+			FragmentLen = 0;
 			rcv_state = ATCMD_FSM_BULK_DATA;
 		}
 		else if ( 'H' == *ptr) {
 			/* HTTP data handling start */
 			/* <Esc>H<Cid><Data Length xxxx 4 ascii char><data>   */
+			FrameHandler = HttpHandler;
+			FrameArg = HttpArg;
+			FragmentLen = 0;
 			rcv_state = ATCMD_FSM_BULK_DATA;
 		}
 		else if ('O' == *ptr) {
@@ -1212,8 +1438,25 @@ ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr)
 			/* ESC y  cid IP_addr <SPC> Port <HT> <Length 4digits> data */
 			spcFlag = false;
 			htabFlag = false;
+			ipIndex = 0;
+			memset( UdpSrcAddr, 0, sizeof(UdpSrcAddr) );
+			UdpSrcPort = 0;
+			FrameHandler = NULL;   /* decided on the CID */
+			FragmentLen = 0;
 			rcv_state = ATCMD_FSM_UDP_BULK_DATA;
 		}
+		else if ( 'K' == *ptr) {
+			/* Message on a subscribed topic */
+			/* ESC K <CID><5 chars><Length 4digits><Topic>SPC<data> */
+			hdrCount = 0;
+			spcFlag = false;
+			MqttTopicLen = 0;
+			MqttTopicTruncated = false;
+			MqttFragmentLen = 0;
+			MqttOffset = 0;
+			MqttTotal = 0;
+			rcv_state = ATCMD_FSM_MQTT_DATA;
+		}
 		else {
 			/* ESC sequence parse error !  */
 			/* Reset the receive buffer */
@@ -1224,7 +1467,21 @@ ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr)
 	case ATCMD_FSM_BULK_DATA:
 		if( !getCid ){
 			/* Store the CID */
-			WiFi_StoreESCBuffer( *ptr );
+			if( 'Z' == escType ){
+				idx = AtCmd_CidIndex( *ptr );
+				if( idx >= 0 && BulkHandlers[idx] ){
+					FrameHandler = BulkHandlers[idx];
+					FrameArg = BulkArgs[idx];
+				}
+				else{
+					FrameHandler = BulkDefault;
+					FrameArg = BulkDefaultArg;
+				}
+			}
+			if( FrameHandler )
+				FrameCid = *ptr;
+			else
+				WiFi_StoreESCBuffer( *ptr );
 			getCid = 1;
 		}
 		else if( dataLenCount < 4 ){
@@ -1234,10 +1491,22 @@ ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr)
 		}
 		else{
 			/* Now read actual data */
-			WiFi_StoreESCBuffer( *ptr );
+			if( FrameHandler ){
+				/* Streamed to the handler, nothing is kept in ESCBuffer */
+				Fragment[FragmentLen++] = *ptr;
+				if( FragmentLen == ATCMD_HTTP_FRAGMENT_SIZE || dataLen == 1 )
+					FlushFragment();
+			}
+			else
+				WiFi_StoreESCBuffer( *ptr );
 			resp = ATCMD_RESP_BULK_DATA_RX;
 			dataLen--;
 			if( !dataLen ){
+				if( FrameHandler ){
+					/* End of the frame */
+					FrameHandler( FrameCid, NULL, 0, FrameArg );
+				}
+				FrameHandler = NULL;
 				rcv_state = ATCMD_FSM_START;
 				resp = ATCMD_RESP_BULK_DATA_RX;
 			}
@@ -1246,20 +1515,39 @@ ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr)
 
 	case ATCMD_FSM_UDP_BULK_DATA:
 		/* ESC y <CID><IP_addr>SPC<Port>HT<Length 4digits> data */
+		/* The source address is parsed into UdpSrcAddr/UdpSrcPort, only CID and data go to ESCBuffer */
 		if( !getCid ){
-			/* Store the CID */
-			WiFi_StoreESCBuffer( *ptr );
+			/* Store the CID, only CIDs with a bulk handler, their own or the default, go to the UDP handler */
+			idx = AtCmd_CidIndex( *ptr );
+			FrameHandler = ( idx >= 0 && ( BulkHandlers[idx] || BulkDefault ) ) ? UdpHandler : NULL;
+			FrameArg = UdpArg;
+			if( FrameHandler )
+				FrameCid = *ptr;
+			else
+				WiFi_StoreESCBuffer( *ptr );
 			getCid = 1;
 		}
-		else if( !spcFlag || !htabFlag ){
-			/* Find <SPC>, then <HT> */
+		else if( !spcFlag ){
+			/* IP address until <SPC> */
 			if( *ptr == 0x20 ){
 				spcFlag = true;
 			}
-			else if( *ptr == 0x09 && spcFlag ){
+			else if( *ptr == '.' ){
+				if( ipIndex < sizeof(ATCMD_IPv4) - 1 )
+					ipIndex++;
+			}
+			else if( isdigit( *ptr ) ){
+				UdpSrcAddr[ipIndex] = UdpSrcAddr[ipIndex] * 10 + *ptr - '0';
+			}
+		}
+		else if( !htabFlag ){
+			/* Port until <HT> */
+			if( *ptr == 0x09 ){
 				htabFlag = true;
 			}
-			WiFi_StoreESCBuffer( *ptr );
+			else if( isdigit( *ptr ) ){
+				UdpSrcPort = UdpSrcPort * 10 + *ptr - '0';
+			}
 		}
 		else if( dataLenCount < 4 ){
 			/* Calculate Data Length */
@@ -1268,14 +1556,66 @@ ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr)
 		}
 		else{
 			/* Now read actual data */
-			WiFi_StoreESCBuffer( *ptr );
+			if( FrameHandler ){
+				/* The source is in UdpSrcAddr/UdpSrcPort already */
+				Fragment[FragmentLen++] = *ptr;
+				if( FragmentLen == ATCMD_HTTP_FRAGMENT_SIZE || dataLen == 1 )
+					FlushFragment();
+			}
+			else
+				WiFi_StoreESCBuffer( *ptr );
 			dataLen--;
 			if( !dataLen ){
+				if( FrameHandler ){
+					FrameHandler( FrameCid, NULL, 0, FrameArg );
+				}
+				FrameHandler = NULL;
 				rcv_state = ATCMD_FSM_START;
 				resp = ATCMD_RESP_UDP_BULK_DATA_RX;
 			}
 		}
 		break;
+
+	case ATCMD_FSM_MQTT_DATA:
+		/* ESC K <CID><5 chars><Length 4digits><Topic>SPC<data> */
+		/* Parsed byte by byte, so a message may span any number of SPI reads */
+		if( hdrCount < 10 ){
+			if( hdrCount == 0 )
+				MqttCid = *ptr;
+			else if( hdrCount >= 6 )
+				MqttTotal = (MqttTotal * 10) + *ptr - '0';
+			hdrCount++;
+		}
+		else if( !spcFlag ){
+			if( *ptr == 0x20 ){
+				MqttTopic[MqttTopicLen] = '\0';
+				spcFlag = true;
+				if( !MqttTotal ){
+					/* Empty message */
+					MQTT_FlushFragment();
+					rcv_state = ATCMD_FSM_START;
+					resp = ATCMD_RESP_MQTT_DATA_RX;
+				}
+			}
+			else if( MqttTopicLen < ATCMD_MQTT_TOPIC_MAX_SIZE ){
+				MqttTopic[MqttTopicLen++] = *ptr;
+			}
+			else{
+				MqttTopicTruncated = true;
+			}
+		}
+		else{
+			MqttFragment[MqttFragmentLen++] = *ptr;
+			if( MqttOffset + MqttFragmentLen == MqttTotal ){
+				MQTT_FlushFragment();
+				rcv_state = ATCMD_FSM_START;
+				resp = ATCMD_RESP_MQTT_DATA_RX;
+			}
+			else if( MqttFragmentLen == ATCMD_MQTT_FRAGMENT_SIZE ){
+				MQTT_FlushFragment();
+			}
+		}
+		break;
 		
 
 	default:
@@ -1336,8 +1676,105 @@ ATCMD_RESP_E AtCmd_RecvResponse(void)
 
 
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_DisconnectCID
+ *---------------------------------------------------------------------------*
+ * Description: CID of the last DISCONNECT message, call this after
+ *              ATCMD_RESP_DISCONNECT is returned.
+ * Outputs: CID, ATCMD_INVALID_CID if not found
+ *---------------------------------------------------------------------------*/
+char AtCmd_DisconnectCID(void)
+{
+	char *p;
+	int i;
+
+	for( i=RespBuffer_Index-1; i>=0; i-- ){
+		if( RespBuffer[i] && (p = strstr( (char *)RespBuffer[i], "DISCONNECT" )) != NULL )
+			return Search_CID( (uint8_t *)p + 10 );
+	}
+
+	return ATCMD_INVALID_CID;
+}
+
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_ConnectCID
+ *---------------------------------------------------------------------------*
+ * Description: CIDs of the last "CONNECT <server CID> <new CID> <ip> <port>"
+ *              message, call this after ATCMD_RESP_TCP_SERVER_CONNECT.
+ * Inputs: char *server -- CID of the listening server, may be NULL
+ * Outputs: CID of the new connection, ATCMD_INVALID_CID if not found
+ *---------------------------------------------------------------------------*/
+char AtCmd_ConnectCID( char *server )
+{
+	char *p;
+	int i;
+
+	for( i=RespBuffer_Index-1; i>=0; i-- ){
+		if( !RespBuffer[i] || (p = strstr( (char *)RespBuffer[i], "CONNECT " )) == NULL )
+			continue;
+		if( p != (char *)RespBuffer[i] && *(p-1) == 'S' )
+			continue;   /* DISCONNECT */
+
+		p += 8;
+		if( server )
+			*server = *p;
+		if( *p && *(p+1) == ' ' )
+			return *(p+2);
+	}
+
+	return ATCMD_INVALID_CID;
+}
+
+
 /*--------------------------------  Layer 4 Communication  -----------------------------------------*/
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_BulkHeader
+ *---------------------------------------------------------------------------*
+ * Description: Write the header of a bulk data frame
+ *              <ESC><'Z'><cid><Data length (4 byte ASCII)>
+ * Inputs: uint8_t *buf -- Buffer to write the header
+ *         uint8_t cid -- Connection ID
+ *         uint16_t dataLen -- Length of data following the header
+ * Outputs: Length of the header
+ *---------------------------------------------------------------------------*/
+uint16_t AtCmd_BulkHeader(uint8_t *buf, uint8_t cid, uint16_t dataLen)
+{
+	char digits[5];
+
+	/* Convert the data length to 4 digit bytes */
+	ConvertNumberTo4DigitASCII(dataLen, digits);
+
+	buf[0] = ATCMD_ESC;
+	buf[1] = 'Z';
+	buf[2] = cid;
+	memcpy( buf+3, digits, 4 );
+
+	return 7;
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_UDP_BulkHeader
+ *---------------------------------------------------------------------------*
+ * Description: Write the header of a UDP server bulk data frame
+ *              <ESC><'Y'><cid><ip>:<port>:<Data Length>
+ * Inputs: uint8_t *buf -- Buffer to write the header (32 bytes at least)
+ *         uint8_t cid -- Connection ID
+ *         uint16_t dataLen -- Length of data following the header
+ *         const ATCMD_IPv4 ip -- Client IP address
+ *         uint16_t port -- Port of UDP client
+ * Outputs: Length of the header
+ *---------------------------------------------------------------------------*/
+uint16_t AtCmd_UDP_BulkHeader(uint8_t *buf, uint8_t cid, uint16_t dataLen, const ATCMD_IPv4 ip, uint16_t port)
+{
+	char digits[5];
+
+	ConvertNumberTo4DigitASCII(dataLen, digits);
+	return sprintf( (char *)buf, "%cY%c%d.%d.%d.%d:%d:%s",
+	                ATCMD_ESC, cid, ip[0], ip[1], ip[2], ip[3], port, digits );
+}
+
 /*---------------------------------------------------------------------------*
  * AtCmd_SendBulkData
  *---------------------------------------------------------------------------*
@@ -1346,24 +1783,18 @@ ATCMD_RESP_E AtCmd_RecvResponse(void)
  * Inputs:
  *      uint8_t cid -- Connection ID
  *      const char *pTxData -- Data to send to the TCP connection
- *      uint16_t dataLen -- Length of data to send
+ *      uint16_t dataLen -- Length of data to send (ATCMD_BULK_MAX_SIZE at most)
  *---------------------------------------------------------------------------*/
 ATCMD_RESP_E AtCmd_SendBulkData(uint8_t cid, const void *txBuf, uint16_t dataLen)
 {
 	#define HEADERSIZE 7
 	SPI_RESP_STATUS_E s;
-	char digits[5]; 
-	char cmd[10];
-
-	memset( cmd, 0, sizeof(cmd) );
 
-	/* Convert the data length to 4 digit bytes */
-	ConvertNumberTo4DigitASCII(dataLen, digits);
-	/* Construct header part of the bulk data string */
-	/*<Esc><'Z'><Cid><Data Length (4 byte ASCII)> <Data> */
-	sprintf( cmd, "%cZ%c%s", ATCMD_ESC, cid, digits );
+	/* TxBuffer holds one frame only, larger data must be split by the caller */
+	if( dataLen > ATCMD_BULK_MAX_SIZE )
+		return ATCMD_RESP_INPUT_TOO_LONG;
 
-	memcpy( TxBuffer, cmd, HEADERSIZE );
+	AtCmd_BulkHeader( TxBuffer, cid, dataLen );
 	memcpy( TxBuffer+HEADERSIZE, txBuf, dataLen );
 	
 	/* Send the bulk data to GS2200 */
@@ -1377,6 +1808,33 @@ ATCMD_RESP_E AtCmd_SendBulkData(uint8_t cid, const void *txBuf, uint16_t dataLen
 }
 
 
+/*---------------------------------------------------------------------------*
+ * UDP_SendFrame
+ *---------------------------------------------------------------------------*
+ * Description: Append data after the header already written in TxBuffer
+ *              and send the <ESC>Y frame
+ * Inputs: uint16_t headerLen -- Length of the header in TxBuffer
+ *         const void *txBuf -- Data to send to the UDP connection
+ *         uint16_t dataLen -- Data Length
+ *---------------------------------------------------------------------------*/
+static ATCMD_RESP_E UDP_SendFrame(uint16_t headerLen, const void *txBuf, uint16_t dataLen)
+{
+	SPI_RESP_STATUS_E s;
+
+	if( headerLen + dataLen > TXBUFFER_SIZE )
+		return ATCMD_RESP_INPUT_TOO_LONG;
+
+	memcpy( TxBuffer+headerLen, txBuf, dataLen );
+
+	/* Send the bulk data to GS2200 */
+	s = WiFi_Write( (char *)TxBuffer, headerLen+dataLen );
+
+	if( s == SPI_RESP_STATUS_OK )
+		return ATCMD_RESP_OK;
+	else
+		return ATCMD_RESP_SPI_ERROR;
+}
+
 /*---------------------------------------------------------------------------*
  * AtCmd_UDP_SendBulkData
  *---------------------------------------------------------------------------*
@@ -1395,33 +1853,50 @@ ATCMD_RESP_E AtCmd_UDP_SendBulkData(
         const char *pUdpClientIP,
         uint16_t udpClientPort)
 {
-	ATCMD_RESP_E resp=ATCMD_RESP_UNMATCH;
-	SPI_RESP_STATUS_E s;
 	char digits[5];
-	char cmd[30];
+	int headerLen;
 
-	if (ATCMD_INVALID_CID != cid) {
+	if (ATCMD_INVALID_CID == cid)
+		return ATCMD_RESP_UNMATCH;
 
-		memset( cmd, 0, sizeof(cmd) );
+	ConvertNumberTo4DigitASCII(dataLen, digits);
+	/* Construct header part of the bulk data string */
+	/*<Esc><'Y'><cid><ip>:<port>:<Data Length><Data> */
+	headerLen = sprintf( (char *)TxBuffer, "%cY%c%s:%d:%s", ATCMD_ESC, cid, pUdpClientIP, udpClientPort, digits );
 
-		ConvertNumberTo4DigitASCII(dataLen, digits);
-		/* Construct header part of the bulk data string */
-		/*<Esc><'Y'><cid><ip>:<port>:<Data Length><Data> */
-		sprintf( cmd, "%cY%c%s:%d:%s", ATCMD_ESC, cid, pUdpClientIP, udpClientPort, digits );
-		
-		memcpy( TxBuffer, cmd, strlen(cmd) );
-		memcpy( TxBuffer+strlen(cmd), txBuf, dataLen );
-		
-		/* Send the bulk data to GS2200 */
-		s = WiFi_Write( (char *)TxBuffer, dataLen+HEADERSIZE );
-		
-		if( s == SPI_RESP_STATUS_OK )
-			resp = ATCMD_RESP_OK;
-		else
-			resp = ATCMD_RESP_SPI_ERROR;
-	}
+	return UDP_SendFrame( headerLen, txBuf, dataLen );
+}
 
-	return resp;
+/*---------------------------------------------------------------------------*
+ * AtCmd_UDP_SendBulkDataTo
+ *---------------------------------------------------------------------------*
+ * Description: Send bulk data in UDP server to a binary address
+ *              <ESC><'Y'><cid><ip>:<port>:<Data Length><Data>
+ * Inputs: uint8_t cid -- Connection ID
+ *         const void *txBuf -- Data to send to the UDP connection
+ *         uint16_t dataLen -- Data Length
+ *         const ATCMD_IPv4 ip -- Client IP address
+ *         uint16_t port -- Port of UDP client
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_UDP_SendBulkDataTo(uint8_t cid, const void *txBuf, uint16_t dataLen, const ATCMD_IPv4 ip, uint16_t port)
+{
+	if (ATCMD_INVALID_CID == cid)
+		return ATCMD_RESP_UNMATCH;
+
+	return UDP_SendFrame( AtCmd_UDP_BulkHeader( TxBuffer, cid, dataLen, ip, port ), txBuf, dataLen );
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_GetUDPSource
+ *---------------------------------------------------------------------------*
+ * Description: Source address of the last <ESC>y frame received
+ * Inputs: ATCMD_IPv4 ip -- IP address is stored
+ *         uint16_t *port -- Port is stored
+ *---------------------------------------------------------------------------*/
+void AtCmd_GetUDPSource(ATCMD_IPv4 ip, uint16_t *port)
+{
+	memcpy( ip, UdpSrcAddr, sizeof(ATCMD_IPv4) );
+	*port = UdpSrcPort;
 }
 
 
@@ -1525,33 +2000,52 @@ ATCMD_RESP_E AtCmd_MQTTCONNECT( char *cid, char *host, char *port, char *clientI
  *---------------------------------------------------------------------------*/
 ATCMD_RESP_E AtCmd_MQTTPUBLISH( char cid, ATCMD_MQTTparams mqtt )
 {
-        #define BUFLEN 180
+	uint16_t len = mqtt.len;
+
+	if( len > sizeof(mqtt.message) )
+		len = sizeof(mqtt.message);
+
+	return AtCmd_MQTTPUBLISH( cid, mqtt.topic, mqtt.message, len, mqtt.QoS, mqtt.retain );
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_MQTTPUBLISH
+ *---------------------------------------------------------------------------*
+ * Description: Send MQTT application message of any size and content
+ *              AT+MQTTPUBLISH announces the length, then <Esc><'N'><cid><Data>
+ *              Data is streamed from the caller buffer without copying.
+ * Inputs: char cid -- Connection ID of MQTT
+ *         const char *topic -- TOPIC on MQTT broker
+ *         const void *data -- message, binary data allowed
+ *         uint32_t len -- message length
+ *         uint8_t QoS -- QoS level
+ *         uint8_t retain -- retain flag
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_MQTTPUBLISH( char cid, const char *topic, const void *data, uint32_t len, uint8_t QoS, uint8_t retain )
+{
+	#define BUFLEN 180
 	char cmd[BUFLEN];
 	ATCMD_RESP_E resp=ATCMD_RESP_UNMATCH;
 	SPI_RESP_STATUS_E s;
 
-
-	if( strlen(mqtt.topic) < BUFLEN - 28 ){
-		sprintf( cmd, "AT+MQTTPUBLISH=%c,%s,%d,%d,%d\r\n", cid, mqtt.topic, mqtt.len, mqtt.QoS, mqtt.retain );
-		if( ATCMD_RESP_OK == AtCmd_SendCommand( cmd ) ){
-			/* MQTT Publish */
-			/*<Esc><'N'><cid><Data> */
-			sprintf( (char *)TxBuffer, "%cN%c%s", ATCMD_ESC, cid, mqtt.message );
-			/* Send the bulk data to GS2200 */
-			s = WiFi_Write( (char *)TxBuffer, strlen((char *)TxBuffer) );
-			
-			if( s == SPI_RESP_STATUS_OK )
-				resp = ATCMD_RESP_OK;
-			else
-				resp = ATCMD_RESP_SPI_ERROR;
-			
-			return resp;
-		}
-	}
-	else
+	if( strlen(topic) >= BUFLEN - 40 )
 		return ATCMD_RESP_INPUT_TOO_LONG;
 
-	return resp;
+	sprintf( cmd, "AT+MQTTPUBLISH=%c,%s,%ld,%d,%d\r\n", cid, topic, len, QoS, retain );
+	resp = AtCmd_SendCommand( cmd );
+	if( ATCMD_RESP_OK != resp )
+		return resp;
+
+	/* MQTT Publish */
+	/*<Esc><'N'><cid><Data> */
+	TxBuffer[0] = ATCMD_ESC;
+	TxBuffer[1] = 'N';
+	TxBuffer[2] = cid;
+	s = WiFi_Write( (char *)TxBuffer, 3 );
+	if( s != SPI_RESP_STATUS_OK )
+		return ATCMD_RESP_SPI_ERROR;
+
+	return SendStreamData( data, len );
 }
 
 /*---------------------------------------------------------------------------*
@@ -1589,6 +2083,40 @@ ATCMD_RESP_E AtCmd_MQTTSUBSCRIBE( char cid, ATCMD_MQTTparams mqtt )
 	return resp;
 }
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_MQTTSUBSCRIBE
+ *---------------------------------------------------------------------------*
+ * Description: Subscribe to a topic, the topic may contain + and # wildcards
+ * Inputs: char cid -- Connection ID of MQTT
+ *         const char *topic -- topic filter
+ *         uint8_t QoS -- QoS level
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_MQTTSUBSCRIBE( char cid, const char *topic, uint8_t QoS )
+{
+	char cmd[ATCMD_MQTT_TOPIC_MAX_SIZE + 32];
+
+	if( strlen(topic) > ATCMD_MQTT_TOPIC_MAX_SIZE )
+		return ATCMD_RESP_INPUT_TOO_LONG;
+
+	sprintf( cmd, "AT+MQTTSUBSCRIBE=%c,%s,%d\r\n", cid, topic, QoS );
+	return AtCmd_SendCommand( cmd );
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_SetMQTTHandler
+ *---------------------------------------------------------------------------*
+ * Description: Register the function called with messages on subscribed
+ *              topics. The payload is passed in fragments of up to
+ *              ATCMD_MQTT_FRAGMENT_SIZE bytes while it is received, so
+ *              nothing is allocated. NULL discards the messages. arg is
+ *              passed back to the handler, e.g. the object it belongs to.
+ *---------------------------------------------------------------------------*/
+void AtCmd_SetMQTTHandler( ATCMD_MQTTHandler handler, void *arg )
+{
+	MqttHandler = handler;
+	MqttArg = arg;
+}
+
 /*---------------------------------------------------------------------------*
  * AtCmd_RecieveMQTTData
  *---------------------------------------------------------------------------*
@@ -1753,6 +2281,20 @@ ATCMD_RESP_E AtCmd_HTTPCONF( ATCMD_HTTP_HEADER_E param, const char *val )
 	return resp;
 }
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_HTTPCONFDEL
+ *---------------------------------------------------------------------------*
+ * Description: Remove a configured HTTP header
+ * Inputs: ATCMD_HTTP_HEADER param -- HTTP header parameter
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_HTTPCONFDEL( ATCMD_HTTP_HEADER_E param )
+{
+	char cmd[32];
+
+	sprintf( cmd, "AT+HTTPCONFDEL=%d\r\n", param );
+	return AtCmd_SendCommand( cmd );
+}
+
 
 /*---------------------------------------------------------------------------*
  * AtCmd_HTTPSEND
@@ -1763,79 +2305,90 @@ ATCMD_RESP_E AtCmd_HTTPCONF( ATCMD_HTTP_HEADER_E param, const char *val )
  *         uint8_t timeout -- timeout of RESPONSE
  *         char *page -- the page being accessed
  *         uint16_t size -- actual content size
- * Note: Support GET, POST method
- * Note: Support only ASCII message
+ * Note: Support all ATCMD_HTTP_METHOD_E methods
  *---------------------------------------------------------------------------*/
 ATCMD_RESP_E AtCmd_HTTPSEND( char cid, ATCMD_HTTP_METHOD_E type, uint8_t timeout, const char *page, const char *msg, uint32_t size )
+{
+	ATCMD_RESP_E resp;
+
+	resp = AtCmd_HTTPSEND_Start( cid, type, timeout, page, size );
+	if( ATCMD_RESP_OK != resp || !AtCmd_HTTPHasBody( type, size ) )
+		return resp;
+
+	ConsoleLog( "Start to send data body");
+	resp = AtCmd_HTTPSEND_Data( msg, size );
+	if( ATCMD_RESP_OK == resp )
+		ConsoleLog( "Send data body DONE");
+
+	return resp;
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_HTTPSEND_Start
+ *---------------------------------------------------------------------------*
+ * Description: Send AT+HTTPSEND, for a request with a body also
+ *              <Esc><'H'><cid>. The body of size bytes is then given by
+ *              AtCmd_HTTPSEND_Data in any number of pieces.
+ * Inputs: char cid -- Connection ID of HTTP
+ *         ATCMD_HTTP_METHOD type -- type of method
+ *         uint8_t timeout -- timeout of RESPONSE
+ *         char *page -- the page being accessed
+ *         uint32_t size -- content size
+ * Note: POST, PUT and POSTRESP always carry a body, the other methods
+ *       only when size is not 0
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_HTTPSEND_Start( char cid, ATCMD_HTTP_METHOD_E type, uint8_t timeout, const char *page, uint32_t size )
 {
 	char cmd[120];
-	ATCMD_RESP_E resp=ATCMD_RESP_UNMATCH;
-	SPI_RESP_STATUS_E s;
+	char esc[3];
+	ATCMD_RESP_E resp;
 
-	if( HTTP_METHOD_GET==type ){
-		sprintf( cmd, "AT+HTTPSEND=%c,%d,%d,%s\r\n", cid, type, timeout, page );
-		return AtCmd_SendCommand( cmd );
-	}
-	else if( HTTP_METHOD_POST==type ){
-		sprintf( cmd, "AT+HTTPSEND=%c,%d,%d,%s,%ld\r\n", cid, type, timeout, page, size );
-		if( ATCMD_RESP_OK == AtCmd_SendCommand( cmd ) ){
-			/* HTTP POST : <Esc><'H'><cid><Data> */
-			
-			/* Send <Esc><'H'><cid> at first */
-			sprintf( (char *)TxBuffer, "%cH%c", ATCMD_ESC, cid );
-			/* Send the bulk data to GS2200 */
-			s = WiFi_Write( (char *)TxBuffer, 3 );
-			
-			if( s != SPI_RESP_STATUS_OK ){
-				resp = ATCMD_RESP_SPI_ERROR;
-				return resp;
-			}
-			
-			ConsoleLog( "Start to send data body");
-			/* Send Data */
-			if( size <= SPI_MAX_SIZE ){
-				do{
-					s = WiFi_Write( msg, size );
-					if( s != SPI_RESP_STATUS_OK )
-						delay(100);
-				}while( s != SPI_RESP_STATUS_OK );
-				
-			}
-			else{
-				while( size>SPI_MAX_SIZE ){
-					memcpy( TxBuffer, msg, SPI_MAX_SIZE );
-					s = WiFi_Write( (char *)TxBuffer, SPI_MAX_SIZE );
-			
-					if( s != SPI_RESP_STATUS_OK ){
-						delay(100);
-						continue;
-					}
-					msg += SPI_MAX_SIZE;
-					size -= SPI_MAX_SIZE;
-					ConsolePrintf( "%d remains\r\n", size);
-				}
-				
-				if( size ){
-					do{
-						s = WiFi_Write( msg, size );
-						if( s != SPI_RESP_STATUS_OK )
-							delay(100);
-					}while( s != SPI_RESP_STATUS_OK );
-				}
-				
-			}
-			
-			ConsoleLog( "Send data body DONE");
-			return ATCMD_RESP_OK;
-		}
-	}
-	else{
+	if( type < HTTP_METHOD_GET || type > HTTP_METHOD_POSTRESP ){
 		ConsolePrintf( "Not support HTTP method : %d\r\n", type );
 		return ATCMD_RESP_ERROR;
 	}
-	
-	return resp;
 
+	if( strlen(page) > sizeof(cmd) - 40 )
+		return ATCMD_RESP_INPUT_TOO_LONG;
+
+	if( !AtCmd_HTTPHasBody( type, size ) ){
+		sprintf( cmd, "AT+HTTPSEND=%c,%d,%d,%s\r\n", cid, type, timeout, page );
+		return AtCmd_SendCommand( cmd );
+	}
+
+	sprintf( cmd, "AT+HTTPSEND=%c,%d,%d,%s,%ld\r\n", cid, type, timeout, page, size );
+	resp = AtCmd_SendCommand( cmd );
+	if( ATCMD_RESP_OK != resp )
+		return resp;
+
+	/* HTTP body : <Esc><'H'><cid><Data> */
+	esc[0] = ATCMD_ESC;
+	esc[1] = 'H';
+	esc[2] = cid;
+	return SendStreamData( esc, sizeof(esc) );
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_HTTPHasBody
+ *---------------------------------------------------------------------------*
+ * Description: true if AtCmd_HTTPSEND_Start expects a body for the request
+ *---------------------------------------------------------------------------*/
+bool AtCmd_HTTPHasBody( ATCMD_HTTP_METHOD_E type, uint32_t size )
+{
+	return ( HTTP_METHOD_POST == type || HTTP_METHOD_PUT == type || HTTP_METHOD_POSTRESP == type || size );
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_HTTPSEND_Data
+ *---------------------------------------------------------------------------*
+ * Description: Send a piece of the HTTP body after AtCmd_HTTPSEND_Start.
+ *              The data goes to SPI straight from the caller's buffer.
+ * Inputs: const void *data -- body data
+ *         uint32_t size -- size of this piece
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_HTTPSEND_Data( const void *data, uint32_t size )
+{
+	return SendStreamData( data, size );
 }
 
 
@@ -1859,6 +2412,62 @@ ATCMD_RESP_E AtCmd_HTTPCLOSE( char cid )
 
 /*---------------------------------  Advanced Services  --------------------------------------*/
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_SetHTTPHandler
+ *---------------------------------------------------------------------------*
+ * Description: Register the function called with the HTTP response data.
+ *              Data of <ESC>H frames is passed in fragments of up to
+ *              ATCMD_HTTP_FRAGMENT_SIZE bytes while it is received instead
+ *              of being stored in ESCBuffer. NULL restores ESCBuffer.
+ *              arg is passed back to the handler.
+ *---------------------------------------------------------------------------*/
+void AtCmd_SetHTTPHandler( ATCMD_HTTPHandler handler, void *arg )
+{
+	HttpHandler = handler;
+	HttpArg = arg;
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_SetBulkHandler
+ *---------------------------------------------------------------------------*
+ * Description: Register the function called with the TCP bulk data of
+ *              <ESC>Z frames of cid, in the same fragments as
+ *              AtCmd_SetHTTPHandler. With ATCMD_INVALID_CID the handler
+ *              takes the CIDs that have none of their own. Frames without
+ *              a handler are stored in ESCBuffer as before. arg is passed
+ *              back to the handler, so each CID may go to another object.
+ *---------------------------------------------------------------------------*/
+void AtCmd_SetBulkHandler( ATCMD_BulkHandler handler, char cid, void *arg )
+{
+	int idx = AtCmd_CidIndex( cid );
+
+	if( idx >= 0 ){
+		BulkHandlers[idx] = handler;
+		BulkArgs[idx] = arg;
+	}
+	else{
+		BulkDefault = handler;
+		BulkDefaultArg = arg;
+	}
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_SetUDPHandler
+ *---------------------------------------------------------------------------*
+ * Description: Register the function called with the datagrams of <ESC>y
+ *              frames (UDP server), in fragments like the bulk handler.
+ *              AtCmd_GetUDPSource gives the source while it is called.
+ *              Only CIDs registered by AtCmd_SetBulkHandler, or all of
+ *              them while the default bulk handler is set, are passed,
+ *              the others stay in ESCBuffer. arg is passed back to the
+ *              handler.
+ *---------------------------------------------------------------------------*/
+void AtCmd_SetUDPHandler( ATCMD_BulkHandler handler, void *arg )
+{
+	UdpHandler = handler;
+	UdpArg = arg;
+}
+
 /*---------------------------------------------------------------------------*
  * AtCmd_DNSLOOKUP
  *---------------------------------------------------------------------------*
@@ -1924,45 +2533,78 @@ ATCMD_RESP_E AtCmd_APCLIENTINFO(void)
 	return resp;
 }
 
+/*---------------------------------------------------------------------------*
+ * AtCmd_TCERTADD_Start
+ *---------------------------------------------------------------------------*
+ * Description: Send AT+TCERTADD and <Esc><'W'>. The certificate of size
+ *              bytes is then given by AtCmd_TCERTADD_Data in any number of
+ *              pieces, so it is not limited by TxBuffer.
+ * Inputs: char *name -- certificate name
+ *         int format -- 0: binary, 1: Base64
+ *         int location -- 0: flash, 1: RAM
+ *         uint32_t size -- certificate size
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_TCERTADD_Start( const char* name, int format, int location, uint32_t size )
+{
+	ATCMD_RESP_E resp;
+	char cmd[80];
+	char esc[2];
+
+	if( strlen(name) > sizeof(cmd) - 40 )
+		return ATCMD_RESP_INPUT_TOO_LONG;
+
+	sprintf( cmd, "AT+TCERTADD=%s,%d,%ld,%d\r\n", name, format, size, location );
+	resp = AtCmd_SendCommand( cmd );
+	if( ATCMD_RESP_OK != resp )
+		return resp;
+
+	esc[0] = ATCMD_ESC;
+	esc[1] = 'W';
+	return SendStreamData( esc, sizeof(esc) );
+}
+
+/*---------------------------------------------------------------------------*
+ * AtCmd_TCERTADD_Data
+ *---------------------------------------------------------------------------*
+ * Description: Send a piece of the certificate after AtCmd_TCERTADD_Start
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_TCERTADD_Data( const void *data, uint32_t size )
+{
+	return SendStreamData( data, size );
+}
+
 #ifndef SUBCORE
 /*---------------------------------------------------------------------------*
  * AtCmd_TCERTADD
+ *---------------------------------------------------------------------------*
+ * Description: Add the certificate read from the current position to
+ *              the end of the file, in pieces of TXBUFFER_SIZE bytes
  *---------------------------------------------------------------------------*/
 ATCMD_RESP_E AtCmd_TCERTADD( char* name, int format, int location, File fp )
 {
-	ATCMD_RESP_E resp=ATCMD_RESP_UNMATCH;
-	SPI_RESP_STATUS_E s;
-	char cmd[80];
-	char *result;
-	
+	ATCMD_RESP_E resp;
+	uint32_t size;
+	int n;
+
 	if (!fp.available())
 		return ATCMD_RESP_INVALID_INPUT;
 
-	
-	if( fp.size() < TXBUFFER_SIZE - 2 ){
-		sprintf( cmd, "AT+TCERTADD=%s,%d,%d,%d\r\n", name, format, fp.size(), location );
-		if( ATCMD_RESP_OK == AtCmd_SendCommand( cmd ) ){
-			TxBuffer[0] = ATCMD_ESC;
-			TxBuffer[1] = 'W';
-			fp.read(&TxBuffer[2], fp.size());
-			s = WiFi_Write( (char *)TxBuffer, fp.size()+2 );
+	size = fp.size() - fp.position();
+	resp = AtCmd_TCERTADD_Start( name, format, location, size );
+	if( ATCMD_RESP_OK != resp )
+		return resp;
 
-			if( s == SPI_RESP_STATUS_OK ){
-		    	puts("ATCMD_RESP_OK");
-				resp = ATCMD_RESP_OK;
-			}else{
-		    	puts("ATCMD_RESP_SPI_ERROR");
-				resp = ATCMD_RESP_SPI_ERROR;
-			}
+	while( size ){
+		n = fp.read( TxBuffer, ( size > TXBUFFER_SIZE ) ? TXBUFFER_SIZE : size );
+		if( n <= 0 )
+			return ATCMD_RESP_INVALID_INPUT;
+		resp = AtCmd_TCERTADD_Data( TxBuffer, n );
+		if( ATCMD_RESP_OK != resp )
 			return resp;
-		}
-	} else {
-		puts("ATCMD_RESP_INPUT_TOO_LONG");
-		return ATCMD_RESP_INPUT_TOO_LONG;
+		size -= n;
 	}
 
-	return AtCmd_RecvResponse();
-
+	return ATCMD_RESP_OK;
 }
 #endif 
 
@@ -1971,35 +2613,29 @@ ATCMD_RESP_E AtCmd_TCERTADD( char* name, int format, int location, File fp )
  *---------------------------------------------------------------------------*/
 ATCMD_RESP_E AtCmd_TCERTADD( char* name, int format, int location, uint8_t* ptr, int size )
 {
-	ATCMD_RESP_E resp=ATCMD_RESP_UNMATCH;
-	SPI_RESP_STATUS_E s;
-	char cmd[80];
-	char *result;
+	ATCMD_RESP_E resp;
 
-	if( size < TXBUFFER_SIZE - 2 ){
-		sprintf( cmd, "AT+TCERTADD=%s,%d,%d,%d\r\n", name, format, size, location );
-		if( ATCMD_RESP_OK == AtCmd_SendCommand( cmd ) ){
-			TxBuffer[0] = ATCMD_ESC;
-			TxBuffer[1] = 'W';
-			memcpy(&TxBuffer[2], ptr, size);
-			s = WiFi_Write( (char *)TxBuffer, size+2 );
+	resp = AtCmd_TCERTADD_Start( name, format, location, size );
+	if( ATCMD_RESP_OK != resp )
+		return resp;
 
-			if( s == SPI_RESP_STATUS_OK ){
-		    	puts("ATCMD_RESP_OK");
-				resp = ATCMD_RESP_OK;
-			}else{
-		    	puts("ATCMD_RESP_SPI_ERROR");
-				resp = ATCMD_RESP_SPI_ERROR;
-			}
-			return resp;
-		}
-	} else {
-		puts("ATCMD_RESP_INPUT_TOO_LONG");
-		return ATCMD_RESP_INPUT_TOO_LONG;
-	}
+	return AtCmd_TCERTADD_Data( ptr, size );
+}
 
-	return AtCmd_RecvResponse();
+/*---------------------------------------------------------------------------*
+ * AtCmd_TCERTDEL
+ *---------------------------------------------------------------------------*
+ * Description: Delete a certificate, e.g. before replacing it in flash
+ *---------------------------------------------------------------------------*/
+ATCMD_RESP_E AtCmd_TCERTDEL( const char* name )
+{
+	char cmd[80];
+
+	if( strlen(name) > sizeof(cmd) - 20 )
+		return ATCMD_RESP_INPUT_TOO_LONG;
 
+	sprintf( cmd, "AT+TCERTDEL=%s\r\n", name );
+	return AtCmd_SendCommand( cmd );
 }
 
 /*---------------------------------------------------------------------------*
@@ -23,12 +23,19 @@
 #endif
 
 #define ATCMD_INVALID_CID            0xFF  /* invalid CID */
+#define ATCMD_MAX_CID                16    /* '0'-'9', 'a'-'f' */
 
 #define ATCMD_BSSID_MAX_LENGTH        20
 #define ATCMD_SSID_MAX_LENGTH         32
 #define ATCMD_MAC_MAX_LENGTH          18
 #define ATCMD_PASSWORD_MAX_LENGTH     32
 
+#define ATCMD_BULK_MAX_SIZE         1400  /* max data length of one <ESC>Z frame */
+#define ATCMD_UDP_HEADER_MAX_SIZE     32  /* <ESC>Y<cid>xxx.xxx.xxx.xxx:ppppp:llll */
+#define ATCMD_MQTT_TOPIC_MAX_SIZE    128  /* messages on longer topics are dropped */
+#define ATCMD_MQTT_FRAGMENT_SIZE     256  /* payload is delivered in pieces of this size */
+#define ATCMD_HTTP_FRAGMENT_SIZE     256  /* HTTP response is delivered in pieces of this size */
+
 #define  ATCMD_CR          0x0D     /* Carriage Return */
 #define  ATCMD_LF          0x0A     /* Line Feed       */
 #define  ATCMD_ESC         0x1B     /* ESC charcter    */
@@ -40,7 +47,8 @@ typedef enum {
 	ATCMD_FSM_RESPONSE,
 	ATCMD_FSM_ESC_START,
 	ATCMD_FSM_BULK_DATA,
-	ATCMD_FSM_UDP_BULK_DATA
+	ATCMD_FSM_UDP_BULK_DATA,
+	ATCMD_FSM_MQTT_DATA
 } ATCMD_FSM_E;
 
 typedef enum {
@@ -66,6 +74,7 @@ typedef enum {
 	ATCMD_RESP_RESPONSE_TIMEOUT,
 	ATCMD_RESP_BULK_DATA_RX,
 	ATCMD_RESP_UDP_BULK_DATA_RX,
+	ATCMD_RESP_MQTT_DATA_RX,
 	ATCMD_RESP_ESC_OK,
 	ATCMD_RESP_ESC_FAIL,
 	ATCMD_RESP_TCP_SERVER_CONNECT,
@@ -176,6 +185,16 @@ typedef struct {
 	char     message[30];
 } ATCMD_MQTTparams;
 
+/* Called for each payload fragment of a subscribed message, offset/total locate it in the message.
+   arg is the pointer given when the handler was registered */
+typedef void (*ATCMD_MQTTHandler)(char cid, const char *topic, const uint8_t *data, uint16_t len, uint32_t offset, uint32_t total, void *arg);
+
+/* Called with the HTTP response data of <ESC>H frames as it is received, len is 0 at the end of each frame */
+typedef void (*ATCMD_HTTPHandler)(char cid, const uint8_t *data, uint16_t len, void *arg);
+
+/* Called with the TCP data of <ESC>Z frames as it is received, len is 0 at the end of each frame */
+typedef void (*ATCMD_BulkHandler)(char cid, const uint8_t *data, uint16_t len, void *arg);
+
 typedef enum {
 	HTTP_HEADER_AUTHORIZATION=2,
 	HTTP_HEADER_CONNECTION=3,
@@ -216,6 +235,9 @@ void AtCmd_Init(void);
 ATCMD_RESP_E AtCmd_AT(void);
 ATCMD_RESP_E AtCmd_VER(void);
 ATCMD_RESP_E AtCmd_ATE(uint8_t n);
+ATCMD_RESP_E AtCmd_ATW(uint8_t n);
+ATCMD_RESP_E AtCmd_ATY(uint8_t n);
+ATCMD_RESP_E AtCmd_ATV(char *active, uint16_t size);
 ATCMD_RESP_E AtCmd_RESET(void);
 ATCMD_RESP_E AtCmd_NMAC_Q(char *mac);
 ATCMD_RESP_E AtCmd_WRXACTIVE(uint8_t n);
@@ -240,6 +262,7 @@ ATCMD_RESP_E AtCmd_NSTCP(char *port, char *cid);
 ATCMD_RESP_E AtCmd_NSUDP(char *port, char *cid);
 ATCMD_RESP_E AtCmd_NCLOSE(uint8_t cid);
 ATCMD_RESP_E AtCmd_NCLOSEALL(void);
+ATCMD_RESP_E AtCmd_NXSETSOCKOPT(uint8_t cid, ATCMD_SOCKET_OPTION_TYPE_E type, ATCMD_SOCKET_OPTION_PARAM_E param, uint32_t value, uint8_t length);
 ATCMD_RESP_E AtCmd_PSDPSLEEP(uint32_t timeout);
 ATCMD_RESP_E AtCmd_PSSTBY(uint32_t x, uint32_t delay, uint8_t alarm1_pol, uint8_t alarm2_pol);
 ATCMD_RESP_E AtCmd_STORENWCONN(void);
@@ -248,17 +271,34 @@ ATCMD_RESP_E AtCmd_SendCommand(char *command);
 ATCMD_RESP_E AtCmd_checkResponse(const char *pBuffer);
 ATCMD_RESP_E AtCmd_ParseRcvData(uint8_t *ptr);
 ATCMD_RESP_E AtCmd_RecvResponse(void);
+char AtCmd_DisconnectCID(void);
+char AtCmd_ConnectCID( char *server );
+int AtCmd_CidIndex( char cid );
+uint16_t AtCmd_BulkHeader(uint8_t *buf, uint8_t cid, uint16_t dataLen);
+uint16_t AtCmd_UDP_BulkHeader(uint8_t *buf, uint8_t cid, uint16_t dataLen, const ATCMD_IPv4 ip, uint16_t port);
 ATCMD_RESP_E AtCmd_SendBulkData(uint8_t cid, const void *txBuf, uint16_t dataLen);
 ATCMD_RESP_E AtCmd_UDP_SendBulkData(uint8_t cid, const void *txBuf, uint16_t dataLen, const char *pUdpClientIP, uint16_t udpClientPort);
+ATCMD_RESP_E AtCmd_UDP_SendBulkDataTo(uint8_t cid, const void *txBuf, uint16_t dataLen, const ATCMD_IPv4 ip, uint16_t port);
+void AtCmd_GetUDPSource(ATCMD_IPv4 ip, uint16_t *port);
 ATCMD_RESP_E WaitForTCPConnection( char *cid, uint32_t timeout );
 ATCMD_RESP_E AtCmd_MQTTCONNECT( char *cid, char *host, char *port, char *clientID, char *UserName, char *Password );
 ATCMD_RESP_E AtCmd_MQTTPUBLISH( char cid, ATCMD_MQTTparams mqttparams );
+ATCMD_RESP_E AtCmd_MQTTPUBLISH( char cid, const char *topic, const void *data, uint32_t len, uint8_t QoS, uint8_t retain );
 ATCMD_RESP_E AtCmd_MQTTSUBSCRIBE( char cid, ATCMD_MQTTparams mqttparams );
+ATCMD_RESP_E AtCmd_MQTTSUBSCRIBE( char cid, const char *topic, uint8_t QoS );
+void AtCmd_SetMQTTHandler( ATCMD_MQTTHandler handler, void *arg );
 ATCMD_RESP_E AtCmd_HTTPOPEN( char *cid, const char *host, const char *port );
 ATCMD_RESP_E AtCmd_HTTPSOPEN( char *cid, const char *host, const char *port, const char *ca_name );
 ATCMD_RESP_E AtCmd_HTTPCONF( ATCMD_HTTP_HEADER_E param, const char *val );
+ATCMD_RESP_E AtCmd_HTTPCONFDEL( ATCMD_HTTP_HEADER_E param );
 ATCMD_RESP_E AtCmd_HTTPSEND( char cid, ATCMD_HTTP_METHOD_E type, uint8_t timeout, const char *page, const char *msg, uint32_t size );
+ATCMD_RESP_E AtCmd_HTTPSEND_Start( char cid, ATCMD_HTTP_METHOD_E type, uint8_t timeout, const char *page, uint32_t size );
+ATCMD_RESP_E AtCmd_HTTPSEND_Data( const void *data, uint32_t size );
+bool AtCmd_HTTPHasBody( ATCMD_HTTP_METHOD_E type, uint32_t size );
 ATCMD_RESP_E AtCmd_HTTPCLOSE( char cid );
+void AtCmd_SetHTTPHandler( ATCMD_HTTPHandler handler, void *arg );
+void AtCmd_SetBulkHandler( ATCMD_BulkHandler handler, char cid, void *arg );
+void AtCmd_SetUDPHandler( ATCMD_BulkHandler handler, void *arg );
 ATCMD_RESP_E AtCmd_DNSLOOKUP( char *host, char *ip );
 ATCMD_RESP_E AtCmd_APCLIENTINFO(void);
 
@@ -266,6 +306,9 @@ ATCMD_RESP_E AtCmd_APCLIENTINFO(void);
 ATCMD_RESP_E AtCmd_TCERTADD( char* name, int format, int location, File fp );
 #endif
 ATCMD_RESP_E AtCmd_TCERTADD( char* name, int format, int location, uint8_t* ptr, int size );
+ATCMD_RESP_E AtCmd_TCERTADD_Start( const char* name, int format, int location, uint32_t size );
+ATCMD_RESP_E AtCmd_TCERTADD_Data( const void *data, uint32_t size );
+ATCMD_RESP_E AtCmd_TCERTDEL( const char* name );
 ATCMD_RESP_E AtCmd_SETTIME(char* time);
 ATCMD_RESP_E AtCmd_SSLCONF(int size);
 ATCMD_RESP_E AtCmd_LOGLVL(int level);
@@ -0,0 +1,118 @@
+/*
+ *  Arduino Client for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "GS2200Client.h"
+
+int GS2200Client::connect(IPAddress ip, uint16_t port)
+{
+	char host[16];
+
+	snprintf(host, sizeof(host), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+	return connect(host, port);
+}
+
+int GS2200Client::connect(const char* host, uint16_t port)
+{
+	stop();
+
+	mCid = mWifi->connect(String(host), String(port));
+	if (mCid == ATCMD_INVALID_CID) {
+		return 0;
+	}
+
+	if (!mWifi->socket_attach(mCid)) {
+		AtCmd_NCLOSE(mCid);
+		mCid = ATCMD_INVALID_CID;
+		return 0;
+	}
+
+	return 1;
+}
+
+size_t GS2200Client::write(const uint8_t* buf, size_t size)
+{
+	if (mCid == ATCMD_INVALID_CID) {
+		return 0;
+	}
+	return mWifi->socket_write(mCid, buf, size);
+}
+
+/*
+ * A reply is expected only after the request went out, so what is
+ * buffered is sent before waiting for data
+ */
+int GS2200Client::available()
+{
+	if (mCid == ATCMD_INVALID_CID) {
+		return 0;
+	}
+
+	mWifi->socket_flush(mCid);
+	mWifi->pump();
+	return mWifi->socket_available(mCid);
+}
+
+int GS2200Client::read()
+{
+	uint8_t c;
+
+	return (read(&c, 1) == 1) ? c : -1;
+}
+
+int GS2200Client::read(uint8_t* buf, size_t size)
+{
+	if (!available()) {
+		return -1;
+	}
+	return mWifi->socket_read(mCid, buf, size);
+}
+
+int GS2200Client::peek()
+{
+	if (!available()) {
+		return -1;
+	}
+	return mWifi->socket_peek(mCid);
+}
+
+void GS2200Client::flush()
+{
+	if (mCid != ATCMD_INVALID_CID) {
+		mWifi->socket_flush(mCid);
+	}
+}
+
+void GS2200Client::stop()
+{
+	if (mCid != ATCMD_INVALID_CID) {
+		mWifi->socket_close(mCid);
+		mCid = ATCMD_INVALID_CID;
+	}
+}
+
+/* Closed by the peer but data left to read still counts as connected */
+uint8_t GS2200Client::connected()
+{
+	if (mCid == ATCMD_INVALID_CID) {
+		return 0;
+	}
+
+	mWifi->pump();
+	return !mWifi->socket_closed(mCid) || mWifi->socket_available(mCid);
+}
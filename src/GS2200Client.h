@@ -0,0 +1,64 @@
+/*
+ *  Arduino Client for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GS2200_CLIENT_h
+#define GS2200_CLIENT_h
+
+#include <Arduino.h>
+#include <Client.h>
+#include <TelitWiFi.h>
+
+/*
+ * Arduino Client on a buffered socket of TelitWiFi. Received data of the
+ * CID is kept in its own ring, so available() is per connection, and
+ * small writes such as print() are collected into full <ESC>Z frames
+ * until flush() or a read. A copy refers to the same connection.
+ */
+class GS2200Client : public Client
+{
+public:
+
+  GS2200Client(TelitWiFi* wifi, char cid = ATCMD_INVALID_CID) : mWifi(wifi), mCid(cid) {}
+  ~GS2200Client(){}
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size);
+  using Print::write;
+
+  int available();
+  int read();
+  int read(uint8_t* buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool() { return mCid != ATCMD_INVALID_CID; }
+
+  char cid() { return mCid; }
+
+private:
+
+  TelitWiFi* mWifi;
+  char mCid;
+};
+
+#endif // GS2200_CLIENT_h
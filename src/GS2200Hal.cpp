@@ -50,6 +50,8 @@ uint32_t ESCBufferCnt = 0;
 
 uint8_t pendingDataFlag = 0;
 
+static uint16_t writeCredit = 0xFFFF;
+
 
 /*---------------------------------------------------------------------------*
  * msDelta
@@ -234,6 +236,7 @@ SPI_RESP_STATUS_E WiFi_Write(const void *txData, uint16_t dataLength)
 	Read_HeaderResponse(hiResponse);
 	// Get the data length GS2200 can receive. This should be the same as requested
 	recvLen = hiResponse[6]<<8 | hiResponse[5];     
+	writeCredit = (WRITE_RESPONSE_OK == hiResponse[1]) ? recvLen : 0;
 	//check response for write_request and also the check the size of data GS2000 can receive
 	if((WRITE_RESPONSE_OK == hiResponse[1]) && (dataLength == recvLen) )
 	{	 
@@ -257,6 +260,19 @@ SPI_RESP_STATUS_E WiFi_Write(const void *txData, uint16_t dataLength)
 }
 
 
+/*---------------------------------------------------------------------------*
+ * WiFi_WriteCredit
+ *---------------------------------------------------------------------------*
+ * Description: Bytes GS2200 could take at the last WRITE_REQUEST, the length
+ *              requested if it took all of it, 0 if it refused the request
+ * Outputs    : uint16_t -- 0xFFFF before the first write
+ *---------------------------------------------------------------------------*/
+uint16_t WiFi_WriteCredit(void)
+{
+	return writeCredit;
+}
+
+
 /*-------------------------------------------------------------------------*
  * Read Functions
  *-------------------------------------------------------------------------*/
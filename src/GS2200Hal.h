@@ -52,6 +52,7 @@ void Init_GS2200_SPI_type(ModuleType type);
 int Get_GPIO37Status(void);
 
 SPI_RESP_STATUS_E WiFi_Write(const void *txData, uint16_t dataLength);
+uint16_t WiFi_WriteCredit(void);
 SPI_RESP_STATUS_E WiFi_Read(uint8_t *rxData, uint16_t *rxDataLen);
 
 void WiFi_InitESCBuffer(void);
@@ -0,0 +1,182 @@
+/*
+ *  Lock-free Bounded Queue for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GS2200_QUEUE_h
+#define GS2200_QUEUE_h
+
+#include <Arduino.h>
+
+typedef struct {
+  uint32_t pushed;   /* items put in */
+  uint32_t popped;   /* items taken out */
+  uint32_t full;     /* items refused because the queue was full */
+  uint16_t depth;    /* items in the queue now */
+  uint16_t peak;     /* most items in the queue at a time */
+  uint32_t dropped;  /* bytes lost before they could be put in, set by the owner of the queue */
+} GS2200QUEUE_Stats;
+
+/*
+ * Bounded queue for several producer and consumer tasks without a lock.
+ * Every cell has a sequence number telling whose turn it is, a task takes
+ * a position with one compare-and-swap and fills or empties the cell in
+ * place, so large items are not copied twice. SIZE is a power of 2.
+ */
+template <typename T, uint16_t SIZE>
+class GS2200Queue
+{
+public:
+
+  GS2200Queue() { reset(); }
+
+  /* Only while no task uses the queue */
+  void reset()
+  {
+    for (uint16_t i = 0; i < SIZE; i++) {
+      mCell[i].seq = i;
+    }
+    mEnqueue = mDequeue = 0;
+    memset(&mStats, 0, sizeof(mStats));
+  }
+
+  /* A cell to fill, NULL if the queue is full. commit() hands it over */
+  T* reserve(uint32_t* ticket)
+  {
+    uint32_t pos = __atomic_load_n(&mEnqueue, __ATOMIC_RELAXED);
+    Cell* cell;
+    int32_t diff;
+
+    for (;;) {
+      cell = &mCell[pos & (SIZE - 1)];
+      diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+      if (diff == 0) {
+        if (__atomic_compare_exchange_n(&mEnqueue, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        __atomic_fetch_add(&mStats.full, 1, __ATOMIC_RELAXED);
+        return NULL;
+      } else {
+        pos = __atomic_load_n(&mEnqueue, __ATOMIC_RELAXED);
+      }
+    }
+
+    *ticket = pos;
+    return &cell->data;
+  }
+
+  void commit(uint32_t ticket)
+  {
+    uint16_t depth, peak;
+
+    __atomic_store_n(&mCell[ticket & (SIZE - 1)].seq, ticket + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&mStats.pushed, 1, __ATOMIC_RELAXED);
+
+    depth = this->depth();
+    peak = __atomic_load_n(&mStats.peak, __ATOMIC_RELAXED);
+    while (depth > peak &&
+           !__atomic_compare_exchange_n(&mStats.peak, &peak, depth, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  }
+
+  /* The oldest item, NULL if the queue is empty. release() frees the cell */
+  T* front(uint32_t* ticket)
+  {
+    uint32_t pos = __atomic_load_n(&mDequeue, __ATOMIC_RELAXED);
+    Cell* cell;
+    int32_t diff;
+
+    for (;;) {
+      cell = &mCell[pos & (SIZE - 1)];
+      diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+      if (diff == 0) {
+        if (__atomic_compare_exchange_n(&mDequeue, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return NULL;
+      } else {
+        pos = __atomic_load_n(&mDequeue, __ATOMIC_RELAXED);
+      }
+    }
+
+    *ticket = pos;
+    return &cell->data;
+  }
+
+  void release(uint32_t ticket)
+  {
+    __atomic_store_n(&mCell[ticket & (SIZE - 1)].seq, ticket + SIZE, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&mStats.popped, 1, __ATOMIC_RELAXED);
+  }
+
+  bool push(const T& item)
+  {
+    uint32_t ticket;
+    T* cell = reserve(&ticket);
+
+    if (!cell) {
+      return false;
+    }
+    *cell = item;
+    commit(ticket);
+    return true;
+  }
+
+  bool pop(T* item)
+  {
+    uint32_t ticket;
+    T* cell = front(&ticket);
+
+    if (!cell) {
+      return false;
+    }
+    *item = *cell;
+    release(ticket);
+    return true;
+  }
+
+  /* Cells taken by producers and not yet by consumers */
+  uint16_t depth()
+  {
+    int32_t n = (int32_t)(__atomic_load_n(&mEnqueue, __ATOMIC_RELAXED) - __atomic_load_n(&mDequeue, __ATOMIC_RELAXED));
+
+    return (n < 0) ? 0 : (n > SIZE) ? SIZE : n;
+  }
+
+  void get_stats(GS2200QUEUE_Stats* stats)
+  {
+    *stats = mStats;
+    stats->depth = depth();
+  }
+
+private:
+
+  static_assert((SIZE & (SIZE - 1)) == 0, "GS2200Queue size must be a power of 2");
+
+  typedef struct {
+    uint32_t seq;
+    T data;
+  } Cell;
+
+  Cell mCell[SIZE];
+  uint32_t mEnqueue;
+  uint32_t mDequeue;
+  GS2200QUEUE_Stats mStats;
+};
+
+#endif // GS2200_QUEUE_h
@@ -0,0 +1,123 @@
+/*
+ *  Arduino Server for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "GS2200Server.h"
+
+void GS2200Server::begin()
+{
+	char port[6];
+
+	end();
+
+	snprintf(port, sizeof(port), "%u", mPort);
+	mCid = mWifi->start_tcp_server(port);
+	if (mCid != ATCMD_INVALID_CID && !mWifi->socket_attach(mCid)) {
+		AtCmd_NCLOSE(mCid);
+		mCid = ATCMD_INVALID_CID;
+	}
+}
+
+GS2200Client GS2200Server::accept()
+{
+	if (mCid == ATCMD_INVALID_CID) {
+		return GS2200Client(mWifi);
+	}
+
+	mWifi->pump();
+	return GS2200Client(mWifi, mWifi->socket_accept(mCid));
+}
+
+/*
+ * The search starts after the client returned last time, so one busy
+ * client does not keep the others waiting. A client returned here is
+ * taken out of the accept queue, accept() does not return it again.
+ */
+GS2200Client GS2200Server::available()
+{
+	char cid = mLast;
+
+	if (mCid == ATCMD_INVALID_CID) {
+		return GS2200Client(mWifi);
+	}
+
+	mWifi->pump();
+
+	for (int i = 0; i < 2 * TWIFI_SOCKET_NUM; i++) {
+		cid = mWifi->socket_accepted(mCid, cid);
+		if (cid == ATCMD_INVALID_CID) {
+			continue;
+		}
+		if (mWifi->socket_available(cid)) {
+			mWifi->socket_accept(mCid, cid);
+			mLast = cid;
+			return GS2200Client(mWifi, cid);
+		}
+		if (mWifi->socket_closed(cid)) {
+			/* Nothing more will come */
+			mWifi->socket_close(cid);
+			cid = mLast = ATCMD_INVALID_CID;
+		}
+	}
+
+	return GS2200Client(mWifi);
+}
+
+/* Connections open now, those closed by the peer with data left included */
+uint8_t GS2200Server::clients()
+{
+	uint8_t n = 0;
+	char cid = ATCMD_INVALID_CID;
+
+	if (mCid == ATCMD_INVALID_CID) {
+		return 0;
+	}
+
+	while ((cid = mWifi->socket_accepted(mCid, cid)) != ATCMD_INVALID_CID) {
+		n++;
+	}
+	return n;
+}
+
+size_t GS2200Server::write(const uint8_t* buf, size_t size)
+{
+	size_t n = 0;
+	char cid = ATCMD_INVALID_CID;
+
+	while ((cid = mWifi->socket_accepted(mCid, cid)) != ATCMD_INVALID_CID) {
+		n = mWifi->socket_write(cid, buf, size);
+		mWifi->socket_flush(cid);
+	}
+
+	return n;
+}
+
+void GS2200Server::end()
+{
+	char cid;
+
+	if (mCid == ATCMD_INVALID_CID) {
+		return;
+	}
+
+	while ((cid = mWifi->socket_accepted(mCid)) != ATCMD_INVALID_CID) {
+		mWifi->socket_close(cid);
+	}
+	mWifi->socket_close(mCid);
+	mCid = mLast = ATCMD_INVALID_CID;
+}
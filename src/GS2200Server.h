@@ -0,0 +1,62 @@
+/*
+ *  Arduino Server for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GS2200_SERVER_h
+#define GS2200_SERVER_h
+
+#include <Arduino.h>
+#include <Server.h>
+#include <TelitWiFi.h>
+#include <GS2200Client.h>
+
+/*
+ * Arduino Server on a listening CID of TelitWiFi. Accepted connections are
+ * attached to buffered sockets and queued as they come, so several clients
+ * can be served from one loop: accept() returns each new connection once,
+ * available() returns one that has data to read, in turn.
+ */
+class GS2200Server : public Server
+{
+public:
+
+  GS2200Server(TelitWiFi* wifi, uint16_t port) : mWifi(wifi), mPort(port), mCid(ATCMD_INVALID_CID),
+                                                 mLast(ATCMD_INVALID_CID) {}
+  ~GS2200Server(){}
+
+  void begin();
+  GS2200Client accept();
+  GS2200Client available();
+  uint8_t clients();
+
+  /* To every accepted client */
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t size);
+  using Print::write;
+
+  void end();
+
+private:
+
+  TelitWiFi* mWifi;
+  uint16_t mPort;
+  char mCid;
+  char mLast;
+};
+
+#endif // GS2200_SERVER_h
@@ -0,0 +1,395 @@
+/*
+ *  I/O Task for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "GS2200Task.h"
+
+GS2200Task* GS2200Task::sInstance = NULL;
+
+static uint16_t cid_bit(char cid)
+{
+	int idx = AtCmd_CidIndex(cid);
+
+	return (idx < 0) ? 0 : 1 << idx;
+}
+
+static void copy_string(char* dst, const char* src, size_t size)
+{
+	strncpy(dst, src ? src : "", size - 1);
+	dst[size - 1] = '\0';
+}
+
+/*
+ * Call after TelitWiFi::begin() and the association, from then on only the
+ * I/O task touches GS2200. One instance at a time.
+ */
+bool GS2200Task::begin(int priority, int stack)
+{
+	if (mRunning) {
+		return true;
+	}
+
+	mCommands.reset();
+	mTxQueue.reset();
+	mRx.reset();
+	mOwned = mUdp = mServers = mAnnounce = 0;
+	mTx = NULL;
+	mDropped = 0;
+	mStop = false;
+	mRunning = true;
+	sInstance = this;
+
+	mPid = task_create("gs2200_io", priority, stack, main, NULL);
+	if (mPid < 0) {
+		ConsolePrintf("GS2200 I/O task not created\r\n");
+		mRunning = false;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * The CIDs stay open, TelitWiFi can be used from the calling task again
+ */
+void GS2200Task::end()
+{
+	mStop = true;
+	while (mRunning) {
+		usleep(GS2200TASK_IDLE * 1000);
+	}
+	mPid = -1;
+}
+
+char GS2200Task::connect(const char* host, const char* port)
+{
+	return command(GS2200TASK_CONNECT, ATCMD_INVALID_CID, host, port, NULL);
+}
+
+char GS2200Task::connectUDP(const char* host, const char* port, const char* local)
+{
+	return command(GS2200TASK_CONNECT_UDP, ATCMD_INVALID_CID, host, port, local);
+}
+
+char GS2200Task::start_tcp_server(const char* port)
+{
+	return command(GS2200TASK_TCP_SERVER, ATCMD_INVALID_CID, NULL, port, NULL);
+}
+
+char GS2200Task::start_udp_server(const char* port)
+{
+	return command(GS2200TASK_UDP_SERVER, ATCMD_INVALID_CID, NULL, port, NULL);
+}
+
+void GS2200Task::close(char cid)
+{
+	command(GS2200TASK_CLOSE, cid, NULL, NULL, NULL);
+}
+
+size_t GS2200Task::write(char cid, const uint8_t* data, size_t length)
+{
+	GS2200TASK_TxFrame* frame;
+	uint32_t ticket;
+	size_t queued = 0;
+	uint16_t n;
+
+	while (queued < length && (frame = mTxQueue.reserve(&ticket)) != NULL) {
+		n = (length - queued < GS2200TASK_FRAME_SIZE) ? length - queued : GS2200TASK_FRAME_SIZE;
+		frame->cid = cid;
+		frame->length = n;
+		memcpy(frame->data, data + queued, n);
+		mTxQueue.commit(ticket);
+		queued += n;
+	}
+	return queued;
+}
+
+void GS2200Task::get_queue_stats(GS2200QUEUE_Stats* command, GS2200QUEUE_Stats* tx, GS2200QUEUE_Stats* rx)
+{
+	if (command) {
+		mCommands.get_stats(command);
+	}
+	if (tx) {
+		mTxQueue.get_stats(tx);
+	}
+	if (rx) {
+		mRx.get_stats(rx);
+		rx->dropped = __atomic_load_n(&mDropped, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * The caller waits on its own flag, the I/O task answers every command
+ * it takes, also when it stops
+ */
+char GS2200Task::command(GS2200TASK_CommandType type, char cid, const char* host, const char* port, const char* local)
+{
+	GS2200TASK_Command* cmd;
+	volatile bool done = false;
+	volatile char result = ATCMD_INVALID_CID;
+	uint32_t ticket;
+
+	if (!mRunning || (cmd = mCommands.reserve(&ticket)) == NULL) {
+		return ATCMD_INVALID_CID;
+	}
+
+	cmd->type = type;
+	cmd->cid = cid;
+	copy_string(cmd->host, host, sizeof(cmd->host));
+	copy_string(cmd->port, port, sizeof(cmd->port));
+	copy_string(cmd->local, local, sizeof(cmd->local));
+	cmd->done = &done;
+	cmd->result = &result;
+	mCommands.commit(ticket);
+
+	while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+		usleep(GS2200TASK_IDLE * 1000);
+	}
+	return result;
+}
+
+int GS2200Task::main(int argc, char* argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	sInstance->run();
+	return 0;
+}
+
+void GS2200Task::run()
+{
+	GS2200TASK_Command* cmd;
+	uint32_t ticket;
+	bool busy;
+
+	while (!mStop) {
+		busy = execute();
+		busy |= transmit();
+		mWifi->supervise();
+		busy |= deliver();
+
+		if (!busy && !Get_GPIO37Status()) {
+			usleep(GS2200TASK_IDLE * 1000);
+		}
+	}
+
+	/* Nobody waits forever */
+	while ((cmd = mCommands.front(&ticket)) != NULL) {
+		__atomic_store_n(cmd->done, true, __ATOMIC_RELEASE);
+		mCommands.release(ticket);
+	}
+	mRunning = false;
+}
+
+bool GS2200Task::execute()
+{
+	GS2200TASK_Command* cmd;
+	uint32_t ticket;
+	char cid;
+	bool busy = false;
+
+	while ((cmd = mCommands.front(&ticket)) != NULL) {
+		busy = true;
+		switch (cmd->type) {
+		case GS2200TASK_CONNECT:
+			cid = mWifi->connect(String(cmd->host), String(cmd->port));
+			own(cid, false, false);
+			break;
+		case GS2200TASK_CONNECT_UDP:
+			cid = mWifi->connectUDP(String(cmd->host), String(cmd->port), String(cmd->local));
+			own(cid, true, false);
+			break;
+		case GS2200TASK_TCP_SERVER:
+			cid = mWifi->start_tcp_server(cmd->port);
+			own(cid, false, true);
+			break;
+		case GS2200TASK_UDP_SERVER:
+			cid = mWifi->start_udp_server(cmd->port);
+			own(cid, true, false);
+			break;
+		case GS2200TASK_CLOSE:
+			disown(cmd->cid);
+			cid = cmd->cid;
+			break;
+		default:
+			cid = ATCMD_INVALID_CID;
+			break;
+		}
+
+		if (cid != ATCMD_INVALID_CID && !(mOwned & cid_bit(cid)) && cmd->type != GS2200TASK_CLOSE) {
+			/* Opened but no socket to buffer it */
+			cid = ATCMD_INVALID_CID;
+		}
+		*cmd->result = cid;
+		__atomic_store_n(cmd->done, true, __ATOMIC_RELEASE);
+		mCommands.release(ticket);
+	}
+	return busy;
+}
+
+/*
+ * Frames go through the coalescing buffers of the sockets, a frame that
+ * is not taken at once stays here and holds the rest of the queue
+ */
+bool GS2200Task::transmit()
+{
+	size_t n;
+	bool busy = false;
+
+	for (;;) {
+		if (!mTx) {
+			if ((mTx = mTxQueue.front(&mTxTicket)) == NULL) {
+				break;
+			}
+			mTxOffset = 0;
+		}
+
+		busy = true;
+		if (!(mOwned & cid_bit(mTx->cid)) || mWifi->socket_closed(mTx->cid)) {
+			/* Nobody to send it to */
+			mTxOffset = mTx->length;
+		} else {
+			n = mWifi->socket_write(mTx->cid, mTx->data + mTxOffset, mTx->length - mTxOffset);
+			if (!n) {
+				/* GS2200 is busy, let the task rest */
+				return false;
+			}
+			mTxOffset += n;
+		}
+
+		if (mTxOffset == mTx->length) {
+			mTxQueue.release(mTxTicket);
+			mTx = NULL;
+		}
+	}
+
+	if (busy) {
+		/* Nothing more to come for now */
+		mWifi->flush();
+	}
+	return busy;
+}
+
+/*
+ * Data is moved from the socket rings into the RX queue while it has room,
+ * a CID is reported closed only after its last data
+ */
+bool GS2200Task::deliver()
+{
+	GS2200TASK_RxFrame* frame;
+	uint32_t ticket;
+	uint16_t bit;
+	uint32_t dropped;
+	char cid, accepted;
+	int n;
+	bool busy = false;
+
+	for (int i = 0; i < 16; i++) {
+		bit = 1 << i;
+		if (!(mOwned & bit)) {
+			continue;
+		}
+		cid = (i < 10) ? '0' + i : 'a' + i - 10;
+
+		if (mServers & bit) {
+			/* TelitWiFi attached them, they are announced before their data */
+			while ((accepted = mWifi->socket_accept(cid)) != ATCMD_INVALID_CID) {
+				mOwned |= cid_bit(accepted);
+				mAnnounce |= cid_bit(accepted);
+				mServerOf[AtCmd_CidIndex(accepted)] = cid;
+				mDroppedSeen[AtCmd_CidIndex(accepted)] = 0;
+			}
+			continue;
+		}
+
+		if (mAnnounce & bit) {
+			if ((frame = mRx.reserve(&ticket)) == NULL) {
+				continue;
+			}
+			frame->cid = cid;
+			frame->event = GS2200TASK_ACCEPTED;
+			frame->server = mServerOf[i];
+			frame->length = 0;
+			mRx.commit(ticket);
+			mAnnounce &= ~bit;
+			busy = true;
+		}
+
+		while (mWifi->socket_available(cid) > 0 && (frame = mRx.reserve(&ticket)) != NULL) {
+			frame->cid = cid;
+			frame->event = GS2200TASK_DATA;
+			if (mUdp & bit) {
+				n = mWifi->socket_recvfrom(cid, frame->data, GS2200TASK_FRAME_SIZE, frame->ip, &frame->port);
+			} else {
+				n = mWifi->socket_read(cid, frame->data, GS2200TASK_FRAME_SIZE);
+			}
+			frame->length = (n > 0) ? n : 0;
+			mRx.commit(ticket);
+			busy = true;
+		}
+
+		dropped = mWifi->socket_dropped(cid);
+		if (dropped != mDroppedSeen[i]) {
+			__atomic_fetch_add(&mDropped, dropped - mDroppedSeen[i], __ATOMIC_RELAXED);
+			mDroppedSeen[i] = dropped;
+		}
+
+		if (mWifi->socket_closed(cid) && !mWifi->socket_available(cid) && (frame = mRx.reserve(&ticket)) != NULL) {
+			frame->cid = cid;
+			frame->event = GS2200TASK_CLOSED;
+			frame->length = 0;
+			mRx.commit(ticket);
+			disown(cid);
+			busy = true;
+		}
+	}
+	return busy;
+}
+
+void GS2200Task::own(char cid, bool udp, bool server)
+{
+	if (cid == ATCMD_INVALID_CID) {
+		return;
+	}
+	if (!mWifi->socket_attach(cid, udp)) {
+		AtCmd_NCLOSE(cid);
+		return;
+	}
+
+	mOwned |= cid_bit(cid);
+	mDroppedSeen[AtCmd_CidIndex(cid)] = 0;
+	if (udp) {
+		mUdp |= cid_bit(cid);
+	}
+	if (server) {
+		mServers |= cid_bit(cid);
+	}
+}
+
+void GS2200Task::disown(char cid)
+{
+	if (!(mOwned & cid_bit(cid))) {
+		return;
+	}
+
+	mWifi->socket_close(cid);
+	mOwned &= ~cid_bit(cid);
+	mUdp &= ~cid_bit(cid);
+	mServers &= ~cid_bit(cid);
+	mAnnounce &= ~cid_bit(cid);
+}
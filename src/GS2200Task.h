@@ -0,0 +1,150 @@
+/*
+ *  I/O Task for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GS2200_TASK_h
+#define GS2200_TASK_h
+
+#include <Arduino.h>
+#include <GS2200Hal.h>
+#include <GS2200AtCmd.h>
+#include <TelitWiFi.h>
+#include <GS2200Queue.h>
+
+#define GS2200TASK_COMMAND_NUM    4     /* power of 2 */
+#define GS2200TASK_TX_NUM         8     /* power of 2 */
+#define GS2200TASK_RX_NUM         8     /* power of 2 */
+#define GS2200TASK_FRAME_SIZE     ATCMD_BULK_MAX_SIZE
+#define GS2200TASK_PRIORITY       110
+#define GS2200TASK_STACK_SIZE     6144  /* ConsolePrintf() alone takes 2 KB of it */
+#define GS2200TASK_IDLE           1     /* ms the task sleeps when there is nothing to do */
+
+typedef enum {
+  GS2200TASK_CONNECT = 0,
+  GS2200TASK_CONNECT_UDP,
+  GS2200TASK_TCP_SERVER,
+  GS2200TASK_UDP_SERVER,
+  GS2200TASK_CLOSE
+} GS2200TASK_CommandType;
+
+typedef struct {
+  GS2200TASK_CommandType type;
+  char cid;                     /* CLOSE */
+  char host[TWIFI_HOST_SIZE];
+  char port[6];                 /* port of the server, or the local port of a server */
+  char local[6];                /* source port of a UDP client */
+  volatile bool* done;          /* of the waiting task */
+  volatile char* result;        /* the CID opened, ATCMD_INVALID_CID on failure */
+} GS2200TASK_Command;
+
+typedef struct {
+  char cid;
+  uint16_t length;
+  uint8_t data[GS2200TASK_FRAME_SIZE];
+} GS2200TASK_TxFrame;
+
+typedef enum {
+  GS2200TASK_DATA = 0,   /* data of the CID, a whole datagram for UDP */
+  GS2200TASK_ACCEPTED,   /* a connection on the server CID, the CID is open now */
+  GS2200TASK_CLOSED      /* closed by the peer or the link was lost, all data was delivered */
+} GS2200TASK_Event;
+
+typedef struct {
+  char cid;
+  GS2200TASK_Event event;
+  char server;           /* ACCEPTED: the listening CID */
+  ATCMD_IPv4 ip;         /* UDP: source of the datagram */
+  uint16_t port;
+  uint16_t length;
+  uint8_t data[GS2200TASK_FRAME_SIZE];
+} GS2200TASK_RxFrame;
+
+/*
+ * Opt-in driver mode for sketches with several tasks. After begin() one
+ * task owns SPI, the parser and TelitWiFi; other tasks must not call them,
+ * they open and close CIDs through the command queue, send through the TX
+ * queue and take data and events from the RX queue. The queues are lock-free,
+ * a full RX queue leaves TCP data in the socket and in GS2200, datagrams that
+ * do not fit in the socket ring any more are dropped and counted in the RX
+ * stats. Only one task should write to a CID, frames of two writers may
+ * interleave.
+ */
+class GS2200Task
+{
+public:
+
+  GS2200Task(TelitWiFi* wifi) : mWifi(wifi), mPid(-1), mRunning(false), mStop(false),
+                                mOwned(0), mUdp(0), mServers(0), mAnnounce(0), mTx(NULL), mTxOffset(0), mDropped(0) {}
+  ~GS2200Task(){}
+
+  bool begin(int priority = GS2200TASK_PRIORITY, int stack = GS2200TASK_STACK_SIZE);
+  void end();
+  bool running() { return mRunning; }
+
+  /* Wait for the I/O task, return the CID or ATCMD_INVALID_CID */
+  char connect(const char* host, const char* port);
+  char connectUDP(const char* host, const char* port, const char* local);
+  char start_tcp_server(const char* port);
+  char start_udp_server(const char* port);
+  void close(char cid);
+
+  /* Queue the data in frames, return the bytes queued */
+  size_t write(char cid, const uint8_t* data, size_t length);
+
+  /* The oldest frame or event, NULL if none. done() gives it back */
+  GS2200TASK_RxFrame* receive(uint32_t* ticket) { return mRx.front(ticket); }
+  void done(uint32_t ticket) { mRx.release(ticket); }
+
+  void get_queue_stats(GS2200QUEUE_Stats* command, GS2200QUEUE_Stats* tx, GS2200QUEUE_Stats* rx);
+
+private:
+
+  char command(GS2200TASK_CommandType type, char cid, const char* host, const char* port, const char* local);
+  void run();
+  bool execute();
+  bool transmit();
+  bool deliver();
+  void own(char cid, bool udp, bool server);
+  void disown(char cid);
+  static int main(int argc, char* argv[]);
+
+  TelitWiFi* mWifi;
+  int mPid;
+  volatile bool mRunning;
+  volatile bool mStop;
+
+  /* Used by the I/O task only, a bit for each CID */
+  uint16_t mOwned;
+  uint16_t mUdp;
+  uint16_t mServers;
+  uint16_t mAnnounce;          /* accepted, ACCEPTED not queued yet */
+  char mServerOf[16];          /* listening CID of an accepted one */
+  GS2200TASK_TxFrame* mTx;     /* being sent */
+  uint32_t mTxTicket;
+  uint16_t mTxOffset;
+  uint32_t mDroppedSeen[16];   /* socket_dropped() of a CID at the last deliver() */
+  uint32_t mDropped;           /* bytes lost in the socket rings, read by other tasks */
+
+  GS2200Queue<GS2200TASK_Command, GS2200TASK_COMMAND_NUM> mCommands;
+  GS2200Queue<GS2200TASK_TxFrame, GS2200TASK_TX_NUM> mTxQueue;
+  GS2200Queue<GS2200TASK_RxFrame, GS2200TASK_RX_NUM> mRx;
+
+  static GS2200Task* sInstance;
+};
+
+#endif // GS2200_TASK_h
@@ -0,0 +1,140 @@
+/*
+ *  Arduino UDP for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "GS2200UDP.h"
+
+uint8_t GS2200UDP::begin(uint16_t port)
+{
+	char p[6];
+
+	stop();
+
+	snprintf(p, sizeof(p), "%u", port);
+	mCid = mWifi->start_udp_server(p);
+	if (mCid == ATCMD_INVALID_CID) {
+		return 0;
+	}
+
+	if (!mWifi->socket_attach(mCid, true)) {
+		AtCmd_NCLOSE(mCid);
+		mCid = ATCMD_INVALID_CID;
+		return 0;
+	}
+
+	return 1;
+}
+
+void GS2200UDP::stop()
+{
+	if (mCid != ATCMD_INVALID_CID) {
+		mWifi->socket_close(mCid);
+		mCid = ATCMD_INVALID_CID;
+	}
+	mTxLen = mRxLen = mRxPos = 0;
+}
+
+int GS2200UDP::beginPacket(IPAddress ip, uint16_t port)
+{
+	for (int i = 0; i < 4; i++) {
+		mTxIp[i] = ip[i];
+	}
+	mTxPort = port;
+	mTxLen = 0;
+
+	return mCid != ATCMD_INVALID_CID;
+}
+
+/* Only dotted addresses, GS2200 resolves names for connect() only */
+int GS2200UDP::beginPacket(const char* host, uint16_t port)
+{
+	int a, b, c, d;
+
+	if (sscanf(host, "%d.%d.%d.%d", &a, &b, &c, &d) != 4) {
+		return 0;
+	}
+	return beginPacket(IPAddress(a, b, c, d), port);
+}
+
+size_t GS2200UDP::write(const uint8_t* buffer, size_t size)
+{
+	if (size > (size_t)(GS2200UDP_PACKET_SIZE - mTxLen)) {
+		size = GS2200UDP_PACKET_SIZE - mTxLen;
+	}
+	memcpy(mTx + mTxLen, buffer, size);
+	mTxLen += size;
+
+	return size;
+}
+
+int GS2200UDP::endPacket()
+{
+	bool result;
+
+	if (mCid == ATCMD_INVALID_CID || !mTxPort) {
+		return 0;
+	}
+
+	result = mWifi->sendto(mCid, mTx, mTxLen, mTxIp, mTxPort);
+	mTxLen = 0;
+
+	return result;
+}
+
+/*
+ * The rest of the previous datagram is discarded, as with other Arduino
+ * UDP classes
+ */
+int GS2200UDP::parsePacket()
+{
+	int n;
+
+	mRxLen = mRxPos = 0;
+	if (mCid == ATCMD_INVALID_CID) {
+		return 0;
+	}
+
+	mWifi->pump();
+	n = mWifi->socket_recvfrom(mCid, mRx, sizeof(mRx), mRxIp, &mRxPort);
+	if (n < 0) {
+		return 0;
+	}
+
+	mRxLen = n;
+	return n;
+}
+
+int GS2200UDP::read()
+{
+	return available() ? mRx[mRxPos++] : -1;
+}
+
+int GS2200UDP::read(unsigned char* buffer, size_t len)
+{
+	if (!available()) {
+		return -1;
+	}
+
+	if (len > (size_t)available()) {
+		len = available();
+	}
+	memcpy(buffer, mRx + mRxPos, len);
+	mRxPos += len;
+
+	return len;
+}
@@ -0,0 +1,81 @@
+/*
+ *  Arduino UDP for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef GS2200_UDP_h
+#define GS2200_UDP_h
+
+#include <Arduino.h>
+#include <Udp.h>
+#include <TelitWiFi.h>
+
+#define GS2200UDP_PACKET_SIZE  ATCMD_BULK_MAX_SIZE
+
+/*
+ * Arduino UDP on a UDP server CID of TelitWiFi. Datagrams are kept whole
+ * with their source in the socket ring, parsePacket() takes the next one.
+ * write() between beginPacket() and endPacket() only fills a buffer, the
+ * datagram goes out in one frame.
+ */
+class GS2200UDP : public UDP
+{
+public:
+
+  GS2200UDP(TelitWiFi* wifi) : mWifi(wifi), mCid(ATCMD_INVALID_CID), mTxLen(0), mTxPort(0),
+                               mRxLen(0), mRxPos(0), mRxPort(0) {}
+  ~GS2200UDP(){}
+
+  uint8_t begin(uint16_t port);
+  void stop();
+
+  int beginPacket(IPAddress ip, uint16_t port);
+  int beginPacket(const char* host, uint16_t port);
+  int endPacket();
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size);
+  using Print::write;
+
+  int parsePacket();
+  int available() { return mRxLen - mRxPos; }
+  int read();
+  int read(unsigned char* buffer, size_t len);
+  int read(char* buffer, size_t len) { return read((unsigned char*)buffer, len); }
+  int peek() { return available() ? mRx[mRxPos] : -1; }
+  void flush() {}
+
+  IPAddress remoteIP() { return IPAddress(mRxIp); }
+  uint16_t remotePort() { return mRxPort; }
+
+private:
+
+  TelitWiFi* mWifi;
+  char mCid;
+
+  uint8_t  mTx[GS2200UDP_PACKET_SIZE];
+  uint16_t mTxLen;
+  ATCMD_IPv4 mTxIp;
+  uint16_t mTxPort;
+
+  uint8_t  mRx[GS2200UDP_PACKET_SIZE];
+  uint16_t mRxLen;
+  uint16_t mRxPos;
+  ATCMD_IPv4 mRxIp;
+  uint16_t mRxPort;
+};
+
+#endif // GS2200_UDP_h
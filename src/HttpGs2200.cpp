@@ -18,6 +18,7 @@
  */
 
 #include "HttpGs2200.h"
+#include <unistd.h>
 
 //#define ENABLE_HTTP_DEBUG
 
@@ -33,11 +34,27 @@
 #endif /* HTTP_DEBUG */
 extern uint8_t ESCBuffer[];
 
+uint32_t HttpGs2200::sHeaderHash[HTTPGS2200_HEADER_NUM];
+uint32_t HttpGs2200::sHeaderSet = 0;
+bool HttpGs2200::sCompressed = false;
+
+HTTPGS2200_CertStamp HttpGs2200::sCert[HTTPGS2200_CERT_NUM];
+uint8_t HttpGs2200::sCertCount = 0;
+bool HttpGs2200::sTlsConfigured = false;
+const char* HttpGs2200::sStampPath = NULL;
+
+#define HTTP_SEND_RETRY  10
+#define HTTP_CONF_RETRY  3
+#define HTTP_BODY_PIECE  1500   /* body read from a producer at a time */
+
 bool HttpGs2200::begin(HTTPGS2200_HostParams* params)
 {
   HTTP_DEBUG("Initialize HTTP");
 
   mCid = ATCMD_INVALID_CID;
+  reset_headers();
+  reset_tls();
+  mWifi->add_event_handler(on_event, this);
 
   mData.host = params->host;
   mData.port = params->port;
@@ -47,50 +64,270 @@ bool HttpGs2200::begin(HTTPGS2200_HostParams* params)
   return true;
 }
 
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, uint32_t length)
+{
+	while (length--) {
+		hash = (hash ^ *data++) * 16777619UL;
+	}
+	return hash;
+}
+
+static uint32_t header_hash(const char *val)
+{
+	return fnv1a(2166136261UL, (const uint8_t*)val, strlen(val));
+}
+
+typedef struct {
+	const uint8_t* ptr;
+	uint32_t remain;
+} CertMemory;
+
+static int memory_producer(uint8_t* buf, uint16_t size, void* arg)
+{
+	CertMemory* mem = (CertMemory*)arg;
+	uint16_t n = (mem->remain < size) ? mem->remain : size;
+
+	memcpy(buf, mem->ptr, n);
+	mem->ptr += n;
+	mem->remain -= n;
+	return n;
+}
+
 #ifndef SUBCORE
+static int file_producer(uint8_t* buf, uint16_t size, void* arg);
+
 bool HttpGs2200::set_cert(char* name, char* time_string, int format, int location, File *fp)
 {
-	bool result = true;
+	static uint8_t buf[HTTP_BODY_PIECE];
+	uint32_t start = fp->position();
+	uint32_t hash = 2166136261UL;
+	int n;
+
+	/* Read it once for the hash, the upload reads it again only if needed */
+	while ((n = fp->read(buf, sizeof(buf))) > 0) {
+		hash = fnv1a(hash, buf, n);
+	}
+	fp->seek(start);
+
+	return provision(name, time_string, format, location, hash, fp->size() - start, file_producer, fp);
+}
 
-	AtCmd_TCERTADD(name, format, location, *fp); 
+/*
+ * Certificates stored in the flash of GS2200 are recorded in this file,
+ * the same certificate is not uploaded again after a reboot
+ */
+void HttpGs2200::set_cert_stamp(const char* path)
+{
+	int n;
 
-    AtCmd_SETTIME(time_string);
-	AtCmd_SSLCONF(100);
-	AtCmd_LOGLVL(2);
+	sStampPath = path;
+	sCertCount = 0;
 
-  return result;
+	File f(path, FILE_READ);
+	if (f) {
+		n = f.read(sCert, sizeof(sCert));
+		sCertCount = (n > 0) ? n / sizeof(HTTPGS2200_CertStamp) : 0;
+		f.close();
+	}
 }
 #endif
 
 bool HttpGs2200::set_cert(char* name, char* time_string, int format, int location, uint8_t* ptr, int size )
 {
+	CertMemory mem = { ptr, (uint32_t)size };
+
+	return provision(name, time_string, format, location, fnv1a(2166136261UL, ptr, size), size, memory_producer, &mem);
+}
+
+/*
+ * Certificates in the RAM of GS2200 and the TLS options are lost with
+ * a reset of the module, begin() assumes it was reset
+ */
+void HttpGs2200::reset_tls()
+{
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < sCertCount; i++) {
+		if (sCert[i].location == 0) {
+			sCert[count++] = sCert[i];
+		}
+	}
+	sCertCount = count;
+	sTlsConfigured = false;
+}
+
+/*
+ * Upload the certificate unless GS2200 already holds the same one, then
+ * set the time and the TLS options once after begin()
+ */
+bool HttpGs2200::provision(const char* name, char* time_string, int format, int location,
+                           uint32_t hash, uint32_t size, TWIFI_Producer producer, void* arg)
+{
+	static uint8_t buf[HTTP_BODY_PIECE];
+	HTTPGS2200_CertStamp* stamp = find_cert(header_hash(name));
+	uint32_t start = millis();
+	uint32_t remain = size;
 	bool result = true;
+	int n;
 
-	AtCmd_TCERTADD(name, format, location, ptr, size); 
+	memset(&mTlsStats, 0, sizeof(mTlsStats));
+	mTlsStats.size = size;
 
-    AtCmd_SETTIME(time_string);
-	AtCmd_SSLCONF(100);
-	AtCmd_LOGLVL(2);
+	if (stamp && stamp->hash == hash && stamp->size == size && stamp->location == location) {
+		mTlsStats.skipped = true;
+	} else {
+		if (stamp && stamp->location == 0) {
+			/* An older one with this name in flash */
+			AtCmd_TCERTDEL(name);
+		}
+
+		result = (ATCMD_RESP_OK == AtCmd_TCERTADD_Start(name, format, location, size));
+		while (result && remain) {
+			n = producer(buf, (remain < sizeof(buf)) ? remain : sizeof(buf), arg);
+			if (n <= 0 || ATCMD_RESP_OK != AtCmd_TCERTADD_Data(buf, n)) {
+				result = false;
+			} else {
+				remain -= n;
+			}
+		}
+
+		if (result) {
+			remember_cert(header_hash(name), hash, size, location);
+		} else if (stamp) {
+			/* Unknown state in the module, upload it next time */
+			stamp->size = 0;
+		}
+		mTlsStats.upload = msDelta(start);
+	}
+
+	if (!sTlsConfigured) {
+		uint32_t t = millis();
 
-  return result;
+		AtCmd_SETTIME(time_string);
+		AtCmd_SSLCONF(100);
+		AtCmd_LOGLVL(2);
+		sTlsConfigured = true;
+		mTlsStats.config = msDelta(t);
+	}
+
+	mTlsStats.total = msDelta(start);
+	ConsolePrintf("TLS setup: %s %ld bytes %s, %ld ms\r\n", name, size,
+	              mTlsStats.skipped ? "already present" : (result ? "uploaded" : "failed"), mTlsStats.total);
+
+	return result;
+}
+
+HTTPGS2200_CertStamp* HttpGs2200::find_cert(uint32_t name)
+{
+	for (uint8_t i = 0; i < sCertCount; i++) {
+		if (sCert[i].name == name) {
+			return &sCert[i];
+		}
+	}
+	return NULL;
 }
 
-void HttpGs2200::config(ATCMD_HTTP_HEADER_E param, const char *val)
+void HttpGs2200::remember_cert(uint32_t name, uint32_t hash, uint32_t size, uint8_t location)
+{
+	HTTPGS2200_CertStamp* stamp = find_cert(name);
+
+	if (!stamp) {
+		if (sCertCount == HTTPGS2200_CERT_NUM) {
+			/* Forget the oldest */
+			memmove(&sCert[0], &sCert[1], sizeof(sCert[0]) * (HTTPGS2200_CERT_NUM - 1));
+			sCertCount--;
+		}
+		stamp = &sCert[sCertCount++];
+	}
+
+	stamp->name = name;
+	stamp->hash = hash;
+	stamp->size = size;
+	stamp->location = location;
+
+#ifndef SUBCORE
+	if (sStampPath && location == 0) {
+		HTTPGS2200_CertStamp flash[HTTPGS2200_CERT_NUM];
+		uint8_t count = 0;
+
+		/* Only the certificates in flash survive a reset of GS2200 */
+		for (uint8_t i = 0; i < sCertCount; i++) {
+			if (sCert[i].location == 0) {
+				flash[count++] = sCert[i];
+			}
+		}
+		unlink(sStampPath);
+		File f(sStampPath, FILE_WRITE);
+		if (f) {
+			f.write((const uint8_t*)flash, sizeof(flash[0]) * count);
+			f.close();
+		}
+	}
+#endif
+}
+
+/*
+ * Configure a header, AT+HTTPCONF is sent only if the value changed
+ */
+bool HttpGs2200::config(ATCMD_HTTP_HEADER_E param, const char *val)
 {
 	ATCMD_RESP_E resp = ATCMD_RESP_UNMATCH;
+	uint32_t hash = header_hash(val);
+	int retry;
 
-	while (1) {
+	if (param < HTTPGS2200_HEADER_NUM && (sHeaderSet & (1UL << param)) && sHeaderHash[param] == hash) {
+		return true;
+	}
+
+	for (retry = 0; retry < HTTP_CONF_RETRY; retry++) {
 		resp = AtCmd_HTTPCONF(param, val);
 
 		if (ATCMD_RESP_OK == resp) {
-			break;
-		} else {
-			printf("config error! err resp = %d, retry...\n", resp);
-			continue;
+			if (param < HTTPGS2200_HEADER_NUM) {
+				sHeaderHash[param] = hash;
+				sHeaderSet |= (1UL << param);
+			}
+			return true;
 		}
+		printf("config error! err resp = %d, retry...\n", resp);
+	}
+
+	/* Unknown state in the module, send it next time */
+	if (param < HTTPGS2200_HEADER_NUM) {
+		sHeaderSet &= ~(1UL << param);
+	}
+	return false;
+}
+
+/*
+ * Configure several headers, only the changed ones cost a command
+ */
+bool HttpGs2200::config(const HTTPGS2200_Header* headers, uint8_t count)
+{
+	bool result = true;
+
+	for (uint8_t i = 0; i < count; i++) {
+		if (!config(headers[i].param, headers[i].value)) {
+			result = false;
+		}
+	}
+	return result;
+}
+
+bool HttpGs2200::unconfig(ATCMD_HTTP_HEADER_E param)
+{
+	if (param < HTTPGS2200_HEADER_NUM) {
+		sHeaderSet &= ~(1UL << param);
 	}
+	return (ATCMD_RESP_OK == AtCmd_HTTPCONFDEL(param));
+}
 
-  return;
+/*
+ * Forget the shadow, e.g. after GS2200 is reset
+ */
+void HttpGs2200::reset_headers()
+{
+	sHeaderSet = 0;
 }
 
 bool HttpGs2200::connect()
@@ -136,6 +373,8 @@ bool HttpGs2200::send(ATCMD_HTTP_METHOD_E type, uint8_t timeout, const char *pag
 	ATCMD_RESP_E resp = ATCMD_RESP_UNMATCH;
 	bool result = false;
 	int retry = 10;
+
+	uncompressed();
 	while (1) {
 		resp = AtCmd_HTTPSEND(mCid, type, timeout, page, msg, size);
 		if (ATCMD_RESP_OK == resp || ATCMD_RESP_BULK_DATA_RX == resp) {
@@ -213,37 +452,441 @@ void HttpGs2200::read_data(uint8_t* data, int length)
 }
 
 bool HttpGs2200::post(const char* url_path, const char* body) {
-	bool result = false;
+	HTTP_DEBUG("POST Start");
+	return send_body(HTTP_METHOD_POST, url_path, body);
+}
+
+bool HttpGs2200::get(const char* url_path) {
+	HTTP_DEBUG("GET Start");
+	return request(HTTP_METHOD_GET, url_path, NULL, 0);
+}
 
+/*
+ * POST a body given in pieces, each piece is sent from its own buffer
+ */
+bool HttpGs2200::post(const char* url_path, const HTTPGS2200_Segment* segments, uint8_t count)
+{
 	HTTP_DEBUG("POST Start");
-	result = connect();
+	return request(HTTP_METHOD_POST, url_path, segments, count);
+}
 
-	WiFi_InitESCBuffer();
+/*
+ * POST length bytes given by the producer, it is called until the body
+ * is complete and must not return 0 earlier
+ */
+bool HttpGs2200::post(const char* url_path, TWIFI_Producer producer, void* arg, uint32_t length)
+{
+	HTTP_DEBUG("POST Start");
+	return stream(HTTP_METHOD_POST, url_path, producer, arg, length);
+}
 
-	HTTP_DEBUG("Socket Open");
-	result = send(HTTP_METHOD_POST, 10, url_path, body, strlen(body));
+bool HttpGs2200::put(const char* url_path, const char* body)
+{
+	HTTP_DEBUG("PUT Start");
+	return send_body(HTTP_METHOD_PUT, url_path, body);
+}
 
-	return result;
+bool HttpGs2200::put(const char* url_path, TWIFI_Producer producer, void* arg, uint32_t length)
+{
+	HTTP_DEBUG("PUT Start");
+	return stream(HTTP_METHOD_PUT, url_path, producer, arg, length);
 }
 
-bool HttpGs2200::get(const char* url_path) {
-	bool result = false;
+bool HttpGs2200::del(const char* url_path)
+{
+	HTTP_DEBUG("DELETE Start");
+	return request(HTTP_METHOD_DELETE, url_path, NULL, 0);
+}
 
-	HTTP_DEBUG("GET Start");
-	result = connect();
-	
+/*
+ * The response has only the status and the headers
+ */
+bool HttpGs2200::head(const char* url_path)
+{
+	HTTP_DEBUG("HEAD Start");
+	return request(HTTP_METHOD_HEAD, url_path, NULL, 0);
+}
+
+/*
+ * GET only when changed, pass last_modified() of the previous response.
+ * wait_response() then returns 304 if the resource is unchanged.
+ */
+bool HttpGs2200::get(const char* url_path, const char* if_modified_since)
+{
+	HTTP_DEBUG("Conditional GET Start");
+
+	if (if_modified_since && *if_modified_since) {
+		if (!config(HTTP_HEADER_IF_MODIFIED_SINCE, if_modified_since)) {
+			return false;
+		}
+		mConditional = true;
+		mConditionalNext = true;
+	}
+
+	return request(HTTP_METHOD_GET, url_path, NULL, 0);
+}
+
+bool HttpGs2200::stream(ATCMD_HTTP_METHOD_E type, const char* url_path, TWIFI_Producer producer, void* arg, uint32_t length)
+{
+	static uint8_t buf[HTTP_BODY_PIECE];
+	int size;
+
+	uncompressed();
+	if (!start(type, url_path, length)) {
+		return false;
+	}
+
+	while (length) {
+		size = producer(buf, (length < sizeof(buf)) ? length : sizeof(buf), arg);
+		if (size <= 0 || (uint32_t)size > length) {
+			ConsolePrintf("HTTP body short by %ld bytes\r\n", length);
+			return false;
+		}
+		if (ATCMD_RESP_OK != AtCmd_HTTPSEND_Data(buf, size)) {
+			return false;
+		}
+		length -= size;
+	}
+
+	return true;
+}
+
+#ifndef SUBCORE
+static int file_producer(uint8_t* buf, uint16_t size, void* arg)
+{
+	return ((File*)arg)->read(buf, size);
+}
+
+/*
+ * POST the rest of the file from its current position
+ */
+bool HttpGs2200::post(const char* url_path, File* file)
+{
+	return post(url_path, file_producer, file, file->size() - file->position());
+}
+#endif
+
+static bool deflate_sink(const uint8_t* data, uint16_t length, void* arg)
+{
+	(void)arg;
+	return (ATCMD_RESP_OK == AtCmd_HTTPSEND_Data(data, length));
+}
+
+void HttpGs2200::set_compression(DeflateGs2200* deflate)
+{
+	mDeflate = deflate;
+	if (!deflate) {
+		uncompressed();
+	}
+}
+
+/*
+ * Content-Length and Content-Encoding of a compressed body are module wide,
+ * every request that is not compressed removes them first
+ */
+void HttpGs2200::uncompressed()
+{
+	if (!sCompressed) {
+		return;
+	}
+	unconfig(HTTP_HEADER_CONTENT_ENCODING);
+	unconfig(HTTP_HEADER_CONTENT_LENGTH);
+	sCompressed = false;
+}
+
+/*
+ * Send a body held in memory. With compression set, Content-Length and
+ * Content-Encoding are configured here for the body actually sent.
+ */
+bool HttpGs2200::send_body(ATCMD_HTTP_METHOD_E type, const char* url_path, const char* body)
+{
+	HTTPGS2200_Segment segment = { body, (uint32_t)strlen(body) };
+	char size_string[12];
+	uint32_t size;
+
+	if (!mDeflate) {
+		return request(type, url_path, &segment, 1);
+	}
+
+	size = mDeflate->prepare(segment.data, segment.length);
+	if (!size) {
+		/* Poor ratio, sent as it is */
+		return request(type, url_path, &segment, 1);
+	}
+
+	HTTP_DEBUG("Body compressed, %ld -> %ld bytes", segment.length, size);
+	snprintf(size_string, sizeof(size_string), "%lu", (unsigned long)size);
+	sCompressed = true;
+	if (!config(HTTP_HEADER_CONTENT_LENGTH, size_string) ||
+	    !config(HTTP_HEADER_CONTENT_ENCODING, mDeflate->encoding()) ||
+	    !start(type, url_path, size)) {
+		return false;
+	}
+	return mDeflate->write(segment.data, segment.length, deflate_sink, NULL);
+}
+
+bool HttpGs2200::request(ATCMD_HTTP_METHOD_E type, const char* url_path, const HTTPGS2200_Segment* segments, uint8_t count)
+{
+	uint32_t length = 0;
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		length += segments[i].length;
+	}
+
+	uncompressed();
+	if (!start(type, url_path, length)) {
+		return false;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (ATCMD_RESP_OK != AtCmd_HTTPSEND_Data(segments[i].data, segments[i].length)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Open the connection and send AT+HTTPSEND, the body follows with
+ * AtCmd_HTTPSEND_Data. Only this part is retried, the body cannot be
+ * produced again.
+ */
+bool HttpGs2200::start(ATCMD_HTTP_METHOD_E type, const char* url_path, uint32_t length)
+{
+	ATCMD_RESP_E resp;
+	bool reused = false;
+	int retry = HTTP_SEND_RETRY;
+
+	if (mStreaming) {
+		/* HEAD has no body whatever the headers say */
+		mParser.reset(HTTP_METHOD_HEAD == type);
+	}
+
+	if (mConditional && !mConditionalNext) {
+		/* If-Modified-Since was for the previous request only */
+		unconfig(HTTP_HEADER_IF_MODIFIED_SINCE);
+		mConditional = false;
+	}
+	mConditionalNext = false;
+
+	if (mKeepAlive) {
+		reused = open();
+	} else {
+		connect();
+		HTTP_DEBUG("Socket Open");
+	}
 	WiFi_InitESCBuffer();
 
-	HTTP_DEBUG("Open Socket");
-	result = send(HTTP_METHOD_GET, 10, url_path, "", 0);
+	while (1) {
+		resp = AtCmd_HTTPSEND_Start(mCid, type, 10, url_path, length);
+		if (ATCMD_RESP_OK == resp || ATCMD_RESP_BULK_DATA_RX == resp) {
+			return true;
+		}
 
-	return result;
+		if (reused) {
+			/* Closed by the server without a DISCONNECT yet, open it again */
+			HTTP_DEBUG("Connection %c lost, reconnect", mCid);
+			drop(mCid);
+			open();
+			WiFi_InitESCBuffer();
+			reused = false;
+			continue;
+		}
+
+		if (retry-- <= 0) {
+			return false;
+		}
+		sleep(1);
+	}
+}
+
+void HttpGs2200::set_keepalive(bool enable)
+{
+	if (enable == mKeepAlive) {
+		return;
+	}
+
+	if (enable) {
+		memset(mPool, 0, sizeof(mPool));
+		for (int i = 0; i < HTTPGS2200_POOL_SIZE; i++) {
+			mPool[i].cid = ATCMD_INVALID_CID;
+		}
+		config(HTTP_HEADER_CONNECTION, "keep-alive");
+	} else {
+		close_all();
+	}
+
+	mKeepAlive = enable;
+}
+
+/*
+ * Select the pooled connection to the current host, opening it if needed.
+ * The least recently used connection is closed when the pool is full.
+ * Returns true if an open connection is reused.
+ */
+bool HttpGs2200::open()
+{
+	int i, slot = -1;
+
+	process_events();
+
+	for (i = 0; i < HTTPGS2200_POOL_SIZE; i++) {
+		if (mPool[i].cid != ATCMD_INVALID_CID &&
+		    !strcmp(mPool[i].host, mData.host) && !strcmp(mPool[i].port, mData.port)) {
+			mCid = mPool[i].cid;
+			mPool[i].lastUsed = millis();
+			return true;
+		}
+	}
+
+	for (i = 0; i < HTTPGS2200_POOL_SIZE; i++) {
+		if (mPool[i].cid == ATCMD_INVALID_CID) {
+			slot = i;
+			break;
+		}
+		if (slot < 0 || (int32_t)(mPool[i].lastUsed - mPool[slot].lastUsed) < 0) {
+			slot = i;
+		}
+	}
+
+	if (mPool[slot].cid != ATCMD_INVALID_CID) {
+		HTTP_DEBUG("Close LRU connection %c", mPool[slot].cid);
+		AtCmd_HTTPCLOSE(mPool[slot].cid);
+	}
+
+	connect();
+	mPool[slot].host = mData.host;
+	mPool[slot].port = mData.port;
+	mPool[slot].cid = mCid;
+	mPool[slot].lastUsed = millis();
+
+	return false;
+}
+
+void HttpGs2200::drop(char cid)
+{
+	for (int i = 0; i < HTTPGS2200_POOL_SIZE; i++) {
+		if (mPool[i].cid == cid) {
+			AtCmd_HTTPCLOSE(cid);
+			mPool[i].cid = ATCMD_INVALID_CID;
+		}
+	}
+}
+
+/*
+ * Pick up DISCONNECT events of pooled connections closed by the server,
+ * TelitWiFi reads GS2200 and passes them to on_event()
+ */
+void HttpGs2200::process_events()
+{
+	mWifi->pump();
+}
+
+void HttpGs2200::on_event(ATCMD_RESP_E event, char cid, void* arg)
+{
+	HttpGs2200* self = (HttpGs2200*)arg;
+
+	if (ATCMD_RESP_DISCONNECT == event) {
+		self->closed(cid);
+		if (self->mWaiting && cid == self->mCid) {
+			/* End of a response without length */
+			self->mParser.finish();
+		}
+	}
+}
+
+void HttpGs2200::closed(char cid)
+{
+	if (!mKeepAlive) {
+		return;
+	}
+
+	for (int i = 0; i < HTTPGS2200_POOL_SIZE; i++) {
+		if (mPool[i].cid == cid) {
+			HTTP_DEBUG("Connection %c closed by server", cid);
+			mPool[i].cid = ATCMD_INVALID_CID;
+		}
+	}
+}
+
+/*
+ * Parse the responses of the next requests while they are received.
+ * The body goes to the callbacks across any number of <ESC>H frames,
+ * it is neither kept in ESCBuffer nor returned by read_data().
+ * NULL returns to the ESCBuffer based receive().
+ */
+void HttpGs2200::set_response_callbacks(const HTTPPARSER_Callbacks* callbacks, void* arg)
+{
+	mStreaming = (callbacks != NULL);
+	mParser.set_callbacks(callbacks, arg);
+
+	if (mStreaming) {
+		AtCmd_SetHTTPHandler(on_data, this);
+	} else {
+		AtCmd_SetHTTPHandler(NULL, NULL);
+	}
+}
+
+void HttpGs2200::on_data(char cid, const uint8_t* data, uint16_t length, void* arg)
+{
+	HttpGs2200* self = (HttpGs2200*)arg;
+
+	if (cid == self->mCid) {
+		self->mParser.feed(data, length);
+	}
+}
+
+/*
+ * Wait until the whole response is received, set_response_callbacks() first.
+ * Returns the HTTP status code, -1 on error or when the deadline passes.
+ */
+int HttpGs2200::wait_response(uint32_t timeout)
+{
+	uint32_t start = millis();
+
+	if (!mStreaming) {
+		/* Nothing feeds the parser, the response stays in ESCBuffer */
+		HTTP_DEBUG("wait_response() without set_response_callbacks()");
+		return -1;
+	}
+
+	mWaiting = true;
+	while (!mParser.done() && !mParser.error()) {
+		/* A server that keeps sending must not hold us past the deadline */
+		if (msDelta(start) > timeout) {
+			HTTP_DEBUG("Response timeout, %ld bytes received", mParser.received());
+			break;
+		}
+		mWifi->pump();
+	}
+	mWaiting = false;
+
+	return mParser.done() ? mParser.status() : -1;
+}
+
+void HttpGs2200::close_all()
+{
+	for (int i = 0; i < HTTPGS2200_POOL_SIZE; i++) {
+		if (mPool[i].cid != ATCMD_INVALID_CID) {
+			AtCmd_HTTPCLOSE(mPool[i].cid);
+			mPool[i].cid = ATCMD_INVALID_CID;
+		}
+	}
+	mCid = ATCMD_INVALID_CID;
 }
 
 bool HttpGs2200::end()
 {
 	ATCMD_RESP_E resp = ATCMD_RESP_UNMATCH;
 	bool result = false;
+
+	if (mKeepAlive) {
+		/* The connection stays in the pool, close_all() closes it */
+		return true;
+	}
+
 	while (1) {
 		resp = AtCmd_HTTPCLOSE(mCid);
 
@@ -24,6 +24,8 @@
 #include <GS2200Hal.h>
 #include <GS2200AtCmd.h>
 #include <TelitWiFi.h>
+#include <HttpParserGs2200.h>
+#include <DeflateGs2200.h>
 
 
 typedef struct {
@@ -31,20 +33,68 @@ typedef struct {
   char *port;
 } HTTPGS2200_HostParams;
 
+#define HTTPGS2200_POOL_SIZE 4   /* keep-alive connections kept open */
+
+#define HTTPGS2200_HEADER_NUM 24  /* ATCMD_HTTP_HEADER_E values */
+
+typedef struct {
+  ATCMD_HTTP_HEADER_E param;
+  const char *value;
+} HTTPGS2200_Header;
+
+/* A piece of a request body */
+typedef struct {
+  const void *data;
+  uint32_t length;
+} HTTPGS2200_Segment;
+
+typedef struct {
+  const char *host;
+  const char *port;
+  char cid;
+  uint32_t lastUsed;
+} HTTPGS2200_Connection;
+
+#define HTTPGS2200_CERT_NUM 4   /* certificates remembered */
+
+/* What GS2200 holds under a certificate name */
+typedef struct {
+  uint32_t name;      /* hash of the name */
+  uint32_t hash;      /* hash of the content */
+  uint32_t size;
+  uint8_t location;   /* 0: flash, 1: RAM */
+} HTTPGS2200_CertStamp;
+
+/* Cost of the last set_cert */
+typedef struct {
+  uint32_t size;      /* certificate bytes */
+  bool skipped;       /* already present, not uploaded */
+  uint32_t upload;    /* ms of AT+TCERTADD */
+  uint32_t config;    /* ms of SETTIME, SSLCONF and LOGLVL, 0 if already done */
+  uint32_t total;     /* ms */
+} HTTPGS2200_TlsStats;
+
 class HttpGs2200
 {
 public:
 
-  HttpGs2200(TelitWiFi* wifi) : mWifi(wifi) {}
-  ~HttpGs2200(){}
+  HttpGs2200(TelitWiFi* wifi) : mWifi(wifi), mKeepAlive(false), mStreaming(false),
+                                mConditional(false), mConditionalNext(false), mWaiting(false), mDeflate(NULL) {}
+  ~HttpGs2200(){ mWifi->remove_event_handler(on_event, this); }
 
   bool begin(HTTPGS2200_HostParams* params);
 #ifndef SUBCORE
   bool set_cert(char* name, char* time_string, int format, int location, File *fp);
+  /* Remember the certificates in the flash of GS2200 across reboots */
+  void set_cert_stamp(const char* path);
 #endif
   bool set_cert(char* name, char* time_string, int format, int location, uint8_t* ptr, int size );
+  void get_tls_stats(HTTPGS2200_TlsStats* stats) { *stats = mTlsStats; }
   bool connect();
-  void config(ATCMD_HTTP_HEADER_E param, const char *val);
+  bool config(ATCMD_HTTP_HEADER_E param, const char *val);
+  bool config(const HTTPGS2200_Header* headers, uint8_t count);
+  bool unconfig(ATCMD_HTTP_HEADER_E param);
+  void reset_headers();
   bool send(ATCMD_HTTP_METHOD_E type, uint8_t timeout, const char *page, const char *msg, uint32_t size);
   int receive(uint8_t* data, int length);
   bool receive(uint64_t timeout = 10000);
@@ -53,11 +103,78 @@ public:
   bool post(const char* url_path, const char* body);
   bool get(const char* url_path);
 
+  /* Streaming request bodies, nothing is staged in RAM */
+  bool post(const char* url_path, const HTTPGS2200_Segment* segments, uint8_t count);
+  bool post(const char* url_path, TWIFI_Producer producer, void* arg, uint32_t length);
+#ifndef SUBCORE
+  bool post(const char* url_path, File* file);
+#endif
+
+  bool put(const char* url_path, const char* body);
+  bool put(const char* url_path, TWIFI_Producer producer, void* arg, uint32_t length);
+  bool del(const char* url_path);
+  bool head(const char* url_path);
+
+  /* Conditional GET, the response is 304 if not modified since the date */
+  bool get(const char* url_path, const char* if_modified_since);
+  const char* last_modified() { return mParser.last_modified(); }
+
+  /* Keep-alive: reuse the connection to the same host/port for the next requests */
+  void set_keepalive(bool enable);
+  void close_all();
+
+  /* Streaming response: parsed while it is received and passed to the callbacks */
+  void set_response_callbacks(const HTTPPARSER_Callbacks* callbacks, void* arg);
+  int wait_response(uint32_t timeout = 10000);
+
+  /* Compress the bodies of post()/put() with a string body, NULL to stop */
+  void set_compression(DeflateGs2200* deflate);
+
 private:
 
+  bool send_body(ATCMD_HTTP_METHOD_E type, const char* url_path, const char* body);
+  void uncompressed();
+  bool provision(const char* name, char* time_string, int format, int location,
+                 uint32_t hash, uint32_t size, TWIFI_Producer producer, void* arg);
+  HTTPGS2200_CertStamp* find_cert(uint32_t name);
+  void remember_cert(uint32_t name, uint32_t hash, uint32_t size, uint8_t location);
+  void reset_tls();
+  bool request(ATCMD_HTTP_METHOD_E type, const char* url_path, const HTTPGS2200_Segment* segments, uint8_t count);
+  bool start(ATCMD_HTTP_METHOD_E type, const char* url_path, uint32_t length);
+  bool stream(ATCMD_HTTP_METHOD_E type, const char* url_path, TWIFI_Producer producer, void* arg, uint32_t length);
+  bool open();
+  void drop(char cid);
+  void process_events();
+  void closed(char cid);
+  static void on_event(ATCMD_RESP_E event, char cid, void* arg);
+  static void on_data(char cid, const uint8_t* data, uint16_t length, void* arg);
+
   TelitWiFi* mWifi;
   char mCid;
 
+  bool mKeepAlive;
+  HTTPGS2200_Connection mPool[HTTPGS2200_POOL_SIZE];
+
+  bool mStreaming;
+  bool mConditional;      /* If-Modified-Since is configured */
+  bool mConditionalNext;  /* and it is for the request being started */
+  bool mWaiting;          /* in wait_response(), a DISCONNECT of mCid ends the response */
+
+  DeflateGs2200* mDeflate;
+
+  /* AT+HTTPCONF is module wide, the shadow is shared by all instances */
+  static uint32_t sHeaderHash[HTTPGS2200_HEADER_NUM];
+  static uint32_t sHeaderSet;
+  static bool sCompressed;       /* Content-Length and Content-Encoding of a compressed body are set */
+
+  /* Certificates and TLS options are module wide as well */
+  static HTTPGS2200_CertStamp sCert[HTTPGS2200_CERT_NUM];
+  static uint8_t sCertCount;
+  static bool sTlsConfigured;
+  static const char* sStampPath;
+  HTTPGS2200_TlsStats mTlsStats;
+  HttpParserGs2200 mParser;
+
   HTTPGS2200_HostParams mData;
 
 };
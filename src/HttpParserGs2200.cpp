@@ -0,0 +1,216 @@
+/*
+ *  HTTP Response Parser for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "HttpParserGs2200.h"
+#include <strings.h>
+
+void HttpParserGs2200::reset(bool noBody)
+{
+  mState = HTTPPARSER_STATUS;
+  mNoBody = noBody;
+  mChunked = false;
+  mStatus = -1;
+  mContentLength = -1;
+  mRemain = 0;
+  mReceived = 0;
+  mLineLen = 0;
+  mLastModified[0] = '\0';
+}
+
+uint16_t HttpParserGs2200::feed(const uint8_t* data, uint16_t length)
+{
+  uint16_t start = length;
+  uint16_t n;
+
+  while (length) {
+    switch (mState) {
+    case HTTPPARSER_STATUS:
+    case HTTPPARSER_HEADER:
+    case HTTPPARSER_CHUNK_SIZE:
+    case HTTPPARSER_CHUNK_END:
+    case HTTPPARSER_TRAILER:
+      if (!line_byte(*data)) {
+        break;
+      }
+
+      /* A complete line is in mLine */
+      if (mState == HTTPPARSER_STATUS) {
+        status_line();
+      } else if (mState == HTTPPARSER_HEADER) {
+        if (mLineLen) {
+          header_line();
+        } else {
+          end_of_headers();
+        }
+      } else if (mState == HTTPPARSER_CHUNK_SIZE) {
+        char* end;
+        mRemain = strtoul(mLine, &end, 16);
+        if (end == mLine) {
+          mState = HTTPPARSER_ERROR;
+        } else {
+          mState = mRemain ? HTTPPARSER_CHUNK_DATA : HTTPPARSER_TRAILER;
+        }
+      } else if (mState == HTTPPARSER_CHUNK_END) {
+        mState = HTTPPARSER_CHUNK_SIZE;
+      } else if (!mLineLen) {
+        /* Empty line after the last chunk */
+        mState = HTTPPARSER_DONE;
+      }
+      mLineLen = 0;
+      break;
+
+    case HTTPPARSER_BODY:
+    case HTTPPARSER_CHUNK_DATA:
+      n = (length < mRemain) ? length : mRemain;
+      body(data, n);
+      data += n;
+      length -= n;
+      mRemain -= n;
+      if (!mRemain) {
+        mState = (mState == HTTPPARSER_BODY) ? HTTPPARSER_DONE : HTTPPARSER_CHUNK_END;
+      }
+      continue;
+
+    case HTTPPARSER_BODY_TO_CLOSE:
+      body(data, length);
+      return start;
+
+    default:
+      /* Done or error, the rest belongs to the next response */
+      return start - length;
+    }
+
+    data++;
+    length--;
+  }
+
+  return start;
+}
+
+void HttpParserGs2200::finish()
+{
+  if (mState == HTTPPARSER_BODY_TO_CLOSE) {
+    mState = HTTPPARSER_DONE;
+  } else if (mState != HTTPPARSER_DONE) {
+    mState = HTTPPARSER_ERROR;
+  }
+}
+
+/*
+ * Collect one line, returns true at the end of the line
+ */
+bool HttpParserGs2200::line_byte(uint8_t c)
+{
+  if (c == '\n') {
+    if (mLineLen && mLine[mLineLen - 1] == '\r') {
+      mLineLen--;
+    }
+    mLine[mLineLen] = '\0';
+    return true;
+  }
+
+  if (mLineLen < HTTPPARSER_LINE_MAX) {
+    mLine[mLineLen++] = c;
+  }
+  return false;
+}
+
+void HttpParserGs2200::status_line()
+{
+  const char* p = mLine;
+
+  if (!mLineLen) {
+    /* Blank line before the status, skip it */
+    return;
+  }
+
+  /* "HTTP/1.1 200 OK", GS2200 may also pass "200 OK" */
+  if (!strncmp(p, "HTTP/", 5)) {
+    p = strchr(p, ' ');
+    if (!p) {
+      mState = HTTPPARSER_ERROR;
+      return;
+    }
+  }
+
+  mStatus = atoi(p);
+  if (mStatus < 100 || mStatus > 999) {
+    mState = HTTPPARSER_ERROR;
+    return;
+  }
+
+  if (mCallbacks && mCallbacks->status) {
+    mCallbacks->status(mStatus, mArg);
+  }
+  mState = HTTPPARSER_HEADER;
+}
+
+void HttpParserGs2200::header_line()
+{
+  char* value = strchr(mLine, ':');
+
+  if (!value) {
+    return;
+  }
+  *value++ = '\0';
+  while (*value == ' ' || *value == '\t') {
+    value++;
+  }
+
+  if (!strcasecmp(mLine, "Content-Length")) {
+    mContentLength = atol(value);
+  } else if (!strcasecmp(mLine, "Transfer-Encoding") && strstr(value, "chunked")) {
+    mChunked = true;
+  } else if (!strcasecmp(mLine, "Last-Modified")) {
+    /* Kept for the If-Modified-Since of the next request */
+    strncpy(mLastModified, value, HTTPPARSER_DATE_MAX);
+    mLastModified[HTTPPARSER_DATE_MAX] = '\0';
+  }
+
+  if (mCallbacks && mCallbacks->header) {
+    mCallbacks->header(mLine, value, mArg);
+  }
+}
+
+void HttpParserGs2200::end_of_headers()
+{
+  if (mStatus < 200) {
+    /* 1xx interim response, the real status follows */
+    mState = HTTPPARSER_STATUS;
+    mChunked = false;
+    mContentLength = -1;
+  } else if (mNoBody || mStatus == 204 || mStatus == 304) {
+    mState = HTTPPARSER_DONE;
+  } else if (mChunked) {
+    mState = HTTPPARSER_CHUNK_SIZE;
+  } else if (mContentLength >= 0) {
+    mRemain = mContentLength;
+    mState = mRemain ? HTTPPARSER_BODY : HTTPPARSER_DONE;
+  } else {
+    mState = HTTPPARSER_BODY_TO_CLOSE;
+  }
+}
+
+void HttpParserGs2200::body(const uint8_t* data, uint16_t length)
+{
+  mReceived += length;
+  if (length && mCallbacks && mCallbacks->body) {
+    mCallbacks->body(data, length, mArg);
+  }
+}
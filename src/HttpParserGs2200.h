@@ -0,0 +1,93 @@
+/*
+ *  HTTP Response Parser for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HTTP_PARSER_GS2200_h
+#define HTTP_PARSER_GS2200_h
+
+#include <Arduino.h>
+
+#define HTTPPARSER_LINE_MAX 256   /* longer status/header lines are truncated */
+#define HTTPPARSER_DATE_MAX  40   /* "Sun, 06 Nov 1994 08:49:37 GMT" */
+
+typedef struct {
+  void (*status)(int code, void* arg);
+  void (*header)(const char* name, const char* value, void* arg);
+  void (*body)(const uint8_t* data, uint16_t length, void* arg);
+} HTTPPARSER_Callbacks;
+
+typedef enum {
+  HTTPPARSER_STATUS = 0,
+  HTTPPARSER_HEADER,
+  HTTPPARSER_BODY,           /* Content-Length */
+  HTTPPARSER_BODY_TO_CLOSE,  /* no length, ends with the connection */
+  HTTPPARSER_CHUNK_SIZE,
+  HTTPPARSER_CHUNK_DATA,
+  HTTPPARSER_CHUNK_END,
+  HTTPPARSER_TRAILER,
+  HTTPPARSER_DONE,
+  HTTPPARSER_ERROR
+} HTTPPARSER_State;
+
+/*
+ * Incremental HTTP/1.1 response parser. Data is fed in pieces of any size,
+ * the body is passed to the callback without buffering the response.
+ */
+class HttpParserGs2200
+{
+public:
+
+  HttpParserGs2200() : mCallbacks(NULL), mArg(NULL) { reset(); }
+  ~HttpParserGs2200(){}
+
+  void set_callbacks(const HTTPPARSER_Callbacks* callbacks, void* arg) { mCallbacks = callbacks; mArg = arg; }
+  void reset(bool noBody = false);
+  uint16_t feed(const uint8_t* data, uint16_t length);   /* returns the bytes consumed */
+  void finish();   /* the connection was closed */
+
+  bool done() { return (mState == HTTPPARSER_DONE); }
+  bool error() { return (mState == HTTPPARSER_ERROR); }
+  int status() { return mStatus; }
+  uint32_t received() { return mReceived; }
+  const char* last_modified() { return mLastModified; }
+
+private:
+
+  bool line_byte(uint8_t c);
+  void status_line();
+  void header_line();
+  void end_of_headers();
+  void body(const uint8_t* data, uint16_t length);
+
+  const HTTPPARSER_Callbacks* mCallbacks;
+  void* mArg;
+
+  HTTPPARSER_State mState;
+  bool mNoBody;
+  bool mChunked;
+  int mStatus;
+  int32_t mContentLength;
+  uint32_t mRemain;
+  uint32_t mReceived;
+
+  char mLastModified[HTTPPARSER_DATE_MAX + 1];
+  char mLine[HTTPPARSER_LINE_MAX + 1];
+  uint16_t mLineLen;
+};
+
+#endif // HTTP_PARSER_GS2200_h
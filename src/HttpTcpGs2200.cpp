@@ -0,0 +1,323 @@
+/*
+ *  HTTP/1.1 Client over TCP sockets for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "HttpTcpGs2200.h"
+
+//#define ENABLE_HTTP_DEBUG
+
+#ifdef ENABLE_HTTP_DEBUG
+#define HTTP_DEBUG(...)    \
+	{\
+	printf("DEBUG:   %s L#%d ", __func__, __LINE__);  \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+	}
+#else
+#define HTTP_DEBUG(...)
+#endif /* HTTP_DEBUG */
+
+#define HTTP_FRAME_HEADER  7    /* <ESC>Z<cid><4 digits> */
+
+bool HttpTcpGs2200::begin(const char* host, const char* port)
+{
+	HTTP_DEBUG("Server: %s, Port: %s", host, port);
+
+	/* A connection to the previous host is closed */
+	end();
+	mHost = host;
+	mPort = port;
+	mWifi->add_event_handler(on_event, this);
+
+	return true;
+}
+
+void HttpTcpGs2200::set_headers(const char* headers)
+{
+	mHeaders = headers;
+}
+
+/*
+ * The request line and the headers are formatted directly after the frame
+ * header in mTx, a body that fits goes into the same frame. Small requests
+ * are collected there and sent together in one SPI write.
+ */
+bool HttpTcpGs2200::request(const char* method, const char* path, const void* body, uint32_t length,
+                            const char* content_type)
+{
+	bool head = !strcmp(method, "HEAD");
+	bool large = false;
+	uint16_t room;
+	uint8_t* frame;
+	int n;
+
+	if (mCount == HTTPTCP_PIPELINE_MAX) {
+		HTTP_DEBUG("Too many requests in flight");
+		return false;
+	}
+
+	if (!open()) {
+		return false;
+	}
+
+	for (int retry = 0; ; retry++) {
+		frame = mTx + mTxLen + HTTP_FRAME_HEADER;
+		room = HTTPTCP_TX_SIZE - mTxLen - HTTP_FRAME_HEADER;
+		if (room > ATCMD_BULK_MAX_SIZE) {
+			room = ATCMD_BULK_MAX_SIZE;
+		}
+
+		n = snprintf((char*)frame, room, "%s %s HTTP/1.1\r\nHost: %s\r\n", method, path, mHost);
+		if (length || content_type) {
+			n += snprintf((char*)frame + n, (n < room) ? room - n : 0,
+			              "Content-Type: %s\r\nContent-Length: %lu\r\n",
+			              content_type ? content_type : "application/octet-stream", (unsigned long)length);
+		}
+		if (mHeaders) {
+			n += snprintf((char*)frame + n, (n < room) ? room - n : 0, "%s", mHeaders);
+		}
+		n += snprintf((char*)frame + n, (n < room) ? room - n : 0, "\r\n");
+
+		if (n < room) {
+			break;
+		}
+		if (retry || !mTxLen || !flush()) {
+			/* Does not fit even in an empty frame */
+			ConsolePrintf("HTTP request header too long\r\n");
+			return false;
+		}
+	}
+
+	if (length) {
+		if (length <= (uint32_t)(room - n)) {
+			memcpy(frame + n, body, length);
+			n += length;
+		} else {
+			large = true;
+		}
+	}
+
+	mTxLen += AtCmd_BulkHeader(mTx + mTxLen, mCid, n) + n;
+
+	if (mParsed == mCount) {
+		/* The parser is idle, this is the next response */
+		mParser.reset(head);
+	}
+	mReq[(mFirst + mCount) % HTTPTCP_PIPELINE_MAX].head = head;
+	mReq[(mFirst + mCount) % HTTPTCP_PIPELINE_MAX].status = -1;
+	mCount++;
+
+	if (large) {
+		/* The headers first, then the body in as many frames as needed */
+		if (!flush() || mWifi->write_stream(mCid, (const uint8_t*)body, length) != length) {
+			end();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * The frames go in one SPI write on the flow of the CID, a stalled CID is
+ * tried again when GS2200 may have room
+ */
+bool HttpTcpGs2200::flush()
+{
+	if (!mTxLen) {
+		return true;
+	}
+
+	if (!mWifi->write_frames(mCid, mTx, mTxLen, HTTPTCP_TIMEOUT)) {
+		ConsolePrintf("HTTP send error, %d bytes dropped\r\n", mTxLen);
+		mTxLen = 0;
+		end();
+		return false;
+	}
+
+	mTxLen = 0;
+	return true;
+}
+
+/*
+ * TelitWiFi reads GS2200, the responses come through on_data() and the
+ * DISCONNECT through on_event()
+ */
+void HttpTcpGs2200::poll()
+{
+	flush();
+	mWifi->pump();
+
+	if (mBroken) {
+		/* Not in step with the server any more, the failed requests stay for wait_response() */
+		disconnect();
+		mBroken = false;
+	}
+}
+
+int HttpTcpGs2200::wait_response(uint32_t timeout)
+{
+	uint32_t start = millis();
+	int status;
+
+	if (!mCount) {
+		return -1;
+	}
+
+	while (!mParsed) {
+		poll();
+		if (!mParsed && msDelta(start) > timeout) {
+			/* The connection is out of step, start over with a new one */
+			HTTP_DEBUG("Response timeout, %ld bytes received", mParser.received());
+			end();
+			return -1;
+		}
+	}
+
+	status = mReq[mFirst].status;
+	mFirst = (mFirst + 1) % HTTPTCP_PIPELINE_MAX;
+	mCount--;
+	mParsed--;
+
+	return status;
+}
+
+void HttpTcpGs2200::end()
+{
+	disconnect();
+	mFirst = mCount = mParsed = 0;
+	mBroken = false;
+}
+
+void HttpTcpGs2200::disconnect()
+{
+	if (mCid != ATCMD_INVALID_CID) {
+		AtCmd_NCLOSE(mCid);
+		AtCmd_SetBulkHandler(NULL, mCid, NULL);
+		mCid = ATCMD_INVALID_CID;
+	}
+	mTxLen = 0;
+}
+
+bool HttpTcpGs2200::open()
+{
+	if (mBroken) {
+		/* Whatever still comes on it belongs to the failed requests */
+		disconnect();
+		mBroken = false;
+	}
+	if (mCid != ATCMD_INVALID_CID) {
+		return true;
+	}
+
+	mCid = mWifi->connect(String(mHost), String(mPort));
+	if (mCid == ATCMD_INVALID_CID) {
+		ConsolePrintf("HTTP connect to %s:%s failed\r\n", mHost, mPort);
+		return false;
+	}
+
+	AtCmd_SetBulkHandler(on_data, mCid, this);
+	return true;
+}
+
+/*
+ * A fragment may hold the end of one response and the start of the next,
+ * the parser stops at the end of a response and the rest is fed again.
+ * After a parse error nothing that follows can be trusted, every request
+ * in flight fails and poll() closes the connection.
+ */
+void HttpTcpGs2200::receive(const uint8_t* data, uint16_t length)
+{
+	uint16_t n;
+
+	while (length) {
+		if (mParsed == mCount) {
+			HTTP_DEBUG("%d bytes without a request", length);
+			return;
+		}
+
+		n = mParser.feed(data, length);
+		data += n;
+		length -= n;
+
+		if (mParser.error()) {
+			HTTP_DEBUG("Parse error, %d requests failed", mCount - mParsed);
+			fail();
+			mBroken = true;
+			return;
+		}
+		if (mParser.done()) {
+			complete();
+		}
+	}
+}
+
+void HttpTcpGs2200::complete()
+{
+	mReq[(mFirst + mParsed) % HTTPTCP_PIPELINE_MAX].status = mParser.done() ? mParser.status() : -1;
+	mParsed++;
+
+	if (mParsed < mCount) {
+		mParser.reset(mReq[(mFirst + mParsed) % HTTPTCP_PIPELINE_MAX].head);
+	}
+}
+
+void HttpTcpGs2200::closed()
+{
+	HTTP_DEBUG("Closed by server, CID: %c", mCid);
+
+	/* A response without length ends here, the rest of the pipeline fails */
+	if (mParsed < mCount) {
+		mParser.finish();
+		complete();
+	}
+	fail();
+
+	AtCmd_SetBulkHandler(NULL, mCid, NULL);
+	mCid = ATCMD_INVALID_CID;
+	mTxLen = 0;
+}
+
+void HttpTcpGs2200::fail()
+{
+	while (mParsed < mCount) {
+		mReq[(mFirst + mParsed) % HTTPTCP_PIPELINE_MAX].status = -1;
+		mParsed++;
+	}
+}
+
+void HttpTcpGs2200::on_data(char cid, const uint8_t* data, uint16_t length, void* arg)
+{
+	HttpTcpGs2200* self = (HttpTcpGs2200*)arg;
+
+	if (cid == self->mCid) {
+		self->receive(data, length);
+	}
+}
+
+void HttpTcpGs2200::on_event(ATCMD_RESP_E event, char cid, void* arg)
+{
+	HttpTcpGs2200* self = (HttpTcpGs2200*)arg;
+
+	if (self->mCid == ATCMD_INVALID_CID) {
+		return;
+	}
+	if ((ATCMD_RESP_DISCONNECT == event && cid == self->mCid) || ATCMD_RESP_DISASSOCIATION_EVENT == event) {
+		self->closed();
+	}
+}
@@ -0,0 +1,103 @@
+/*
+ *  HTTP/1.1 Client over TCP sockets for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HTTP_TCP_GS2200_h
+#define HTTP_TCP_GS2200_h
+
+#include <Arduino.h>
+#include <GS2200Hal.h>
+#include <GS2200AtCmd.h>
+#include <TelitWiFi.h>
+#include <HttpParserGs2200.h>
+
+#define HTTPTCP_PIPELINE_MAX  4      /* requests sent before their responses */
+#define HTTPTCP_TX_SIZE    1500      /* requests packed into one SPI write */
+#define HTTPTCP_TIMEOUT   10000      /* ms */
+
+typedef struct {
+  bool head;     /* HEAD, the response has no body */
+  int status;    /* -1: failed */
+} HTTPTCP_Request;
+
+/*
+ * HTTP/1.1 client built on the TCP bulk frames of TelitWiFi instead of
+ * AT+HTTP*. Requests are written straight into <ESC>Z frames, several of
+ * them can be sent before the responses come back (pipelining), and the
+ * connection is kept open between requests.
+ */
+class HttpTcpGs2200
+{
+public:
+
+  HttpTcpGs2200(TelitWiFi* wifi) : mWifi(wifi), mCid(ATCMD_INVALID_CID), mHeaders(NULL),
+                                   mTxLen(0), mFirst(0), mCount(0), mParsed(0), mBroken(false) {}
+  ~HttpTcpGs2200(){ end(); mWifi->remove_event_handler(on_event, this); }
+
+  bool begin(const char* host, const char* port);
+  void set_headers(const char* headers);   /* extra "Name: value\r\n" lines for every request */
+  void set_callbacks(const HTTPPARSER_Callbacks* callbacks, void* arg) { mParser.set_callbacks(callbacks, arg); }
+
+  /* Queue a request, it is sent by flush(), poll() or wait_response() */
+  bool request(const char* method, const char* path, const void* body = NULL, uint32_t length = 0,
+               const char* content_type = NULL);
+  bool get(const char* path) { return request("GET", path); }
+  bool head(const char* path) { return request("HEAD", path); }
+  bool post(const char* path, const char* body, const char* content_type = "application/json")
+    { return request("POST", path, body, strlen(body), content_type); }
+
+  bool flush();
+  void poll();
+
+  /* Status of the oldest request, -1 on error or timeout */
+  int wait_response(uint32_t timeout = HTTPTCP_TIMEOUT);
+  uint8_t pending() { return mCount; }
+
+  void end();
+
+private:
+
+  bool open();
+  void disconnect();
+  void receive(const uint8_t* data, uint16_t length);
+  void complete();
+  void fail();
+  void closed();
+  static void on_data(char cid, const uint8_t* data, uint16_t length, void* arg);
+  static void on_event(ATCMD_RESP_E event, char cid, void* arg);
+
+  TelitWiFi* mWifi;
+  const char* mHost;
+  const char* mPort;
+  char mCid;
+  const char* mHeaders;
+
+  uint8_t  mTx[HTTPTCP_TX_SIZE];
+  uint16_t mTxLen;
+
+  /* Requests in the order they were sent, the first mParsed have their response */
+  HTTPTCP_Request mReq[HTTPTCP_PIPELINE_MAX];
+  uint8_t mFirst;
+  uint8_t mCount;
+  uint8_t mParsed;
+  bool mBroken;      /* a response could not be parsed, poll() closes the connection */
+
+  HttpParserGs2200 mParser;
+};
+
+#endif // HTTP_TCP_GS2200_h
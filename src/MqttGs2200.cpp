@@ -37,6 +37,7 @@ bool MqttGs2200::begin(MQTTGS2200_HostParams* params)
 #endif
 
   mCid = ATCMD_INVALID_CID;
+  mWifi->add_event_handler(on_event, this);
 
   mData.clientID = params->clientID;
   mData.host = params->host;
@@ -78,6 +79,8 @@ bool MqttGs2200::connect()
 		resp = AtCmd_NSTAT(&networkStatus);
 	} while (ATCMD_RESP_OK != resp);
 
+	mConnected = true;
+
 	ConsoleLog( "Connected" );
 	ConsolePrintf("IP: %d.%d.%d.%d\r\n", 
 	              networkStatus.addr.ipv4[0], networkStatus.addr.ipv4[1], networkStatus.addr.ipv4[2], networkStatus.addr.ipv4[3]);
@@ -86,14 +89,199 @@ bool MqttGs2200::connect()
 
 bool MqttGs2200::publish(MQTTGS2200_Mqtt* mqtt)
 {
-  if (ATCMD_RESP_OK != AtCmd_MQTTPUBLISH(mCid, mqtt->params)) {
+  uint16_t len = mqtt->params.len;
+
+  if (len > sizeof(mqtt->params.message)) {
+    len = sizeof(mqtt->params.message);
+  }
+
+  return publish(mqtt->params.topic, mqtt->params.message, len, mqtt->params.QoS, mqtt->params.retain);
+}
+
+#define QUEUE_FLAG_QOS     0x03
+#define QUEUE_FLAG_RETAIN  0x04
+
+bool MqttGs2200::publish(const char* topic, const void* data, uint32_t length, uint8_t qos, bool retain)
+{
+  if (!mQueue) {
+    return send(topic, data, length, qos, retain);
+  }
+
+  /* Older messages go first */
+  if (!mQueue->empty()) {
+    flush();
+  }
+
+  if (mQueue->empty() && send(topic, data, length, qos, retain)) {
+    return true;
+  }
+
+  return (0 != mQueue->push(topic, data, length, (qos & QUEUE_FLAG_QOS) | (retain ? QUEUE_FLAG_RETAIN : 0)));
+}
+
+void MqttGs2200::set_offline_queue(OfflineQueueGs2200* queue)
+{
+  mQueue = queue;
+
+  /* Draining needs the session to stay open between messages */
+  if (mQueue) {
+    set_persistent(true);
+  }
+}
+
+/*
+ * Send the queued messages while the broker accepts them
+ */
+uint32_t MqttGs2200::flush()
+{
+  if (!mQueue) {
+    return 0;
+  }
+
+  return mQueue->drain(send_queued, this);
+}
+
+bool MqttGs2200::send_queued(const OFFLINEQUEUE_Record* rec, const char* topic, const uint8_t* data, void* arg)
+{
+  MqttGs2200* self = (MqttGs2200*)arg;
+
+  return self->send(topic, data, rec->dataLen, rec->flags & QUEUE_FLAG_QOS, rec->flags & QUEUE_FLAG_RETAIN);
+}
+
+bool MqttGs2200::send(const char* topic, const void* data, uint32_t length, uint8_t qos, bool retain)
+{
+  ATCMD_RESP_E resp;
+
+  if (!mStats.published && !mStats.failed) {
+    mStatsStart = millis();
+  }
+
+  if (mPersistent) {
+    /* Pick up a DISCONNECT reported since the last publish */
+    process_events();
+    if (!mConnected && !reconnect()) {
+      mStats.failed++;
+      return false;
+    }
+  }
+
+  resp = AtCmd_MQTTPUBLISH(mCid, topic, data, length, qos, retain);
+  if (ATCMD_RESP_OK != resp) {
+    mStats.failed++;
+    if (mPersistent && ATCMD_RESP_INPUT_TOO_LONG != resp) {
+      /* The broker connection is most likely gone, reconnect on the next publish */
+      mConnected = false;
+    }
 		return false;
   }
 
-  mWifi->stop(mCid);
+  mStats.published++;
+  mStats.elapsed = msDelta(mStatsStart);
+  mStats.rate = mStats.elapsed ? (uint32_t)((uint64_t)mStats.published * 1000 / mStats.elapsed) : 0;
+
+  if (!mPersistent) {
+    mWifi->stop(mCid);
+  }
   return true;
 }
 
+void MqttGs2200::set_persistent(bool enable)
+{
+  mPersistent = enable;
+}
+
+bool MqttGs2200::connected()
+{
+  return mConnected;
+}
+
+/*
+ * Process the events already pending on GS2200 without waiting, messages
+ * on subscribed topics are passed to their callbacks.
+ * Returns false if the broker connection was closed.
+ */
+bool MqttGs2200::poll()
+{
+  process_events();
+
+  if (mQueue && !mQueue->empty() && (mConnected || reconnect())) {
+    flush();
+  }
+
+  return mConnected;
+}
+
+/*
+ * TelitWiFi reads GS2200, the data and events of other CIDs stay with
+ * their owners and the DISCONNECT of ours comes back through on_event()
+ */
+void MqttGs2200::process_events()
+{
+  mWifi->pump();
+}
+
+void MqttGs2200::on_event(ATCMD_RESP_E event, char cid, void* arg)
+{
+  MqttGs2200* self = (MqttGs2200*)arg;
+
+  if (ATCMD_RESP_DISCONNECT == event) {
+    if (cid == self->mCid) {
+      ConsoleLog("MQTT broker disconnected");
+      self->mConnected = false;
+    }
+  } else if (ATCMD_RESP_DISASSOCIATION_EVENT == event) {
+    self->mConnected = false;
+  }
+}
+
+void MqttGs2200::end()
+{
+  mWifi->remove_event_handler(on_event, this);
+}
+
+/*
+ * Reconnect to the broker with exponential backoff
+ */
+bool MqttGs2200::reconnect()
+{
+  if (mReconnectAt && (int32_t)(millis() - mReconnectAt) < 0) {
+    return false;
+  }
+
+  if (mCid != ATCMD_INVALID_CID) {
+    AtCmd_NCLOSE(mCid);
+    mCid = ATCMD_INVALID_CID;
+  }
+
+  if (connect()) {
+    /* The broker does not keep our subscriptions on a clean session */
+    for (uint8_t i = 0; i < mSubCount; i++) {
+      AtCmd_MQTTSUBSCRIBE(mCid, mSubs[i].filter, mSubs[i].qos);
+    }
+    mStats.reconnects++;
+    mReconnectAt = 0;
+    mReconnectWait = MQTTGS2200_RECONNECT_MIN;
+    return true;
+  }
+
+  mReconnectAt = millis() + mReconnectWait;
+  mReconnectWait *= 2;
+  if (mReconnectWait > MQTTGS2200_RECONNECT_MAX) {
+    mReconnectWait = MQTTGS2200_RECONNECT_MAX;
+  }
+  return false;
+}
+
+void MqttGs2200::get_stats(MQTTGS2200_Stats* stats)
+{
+  *stats = mStats;
+}
+
+void MqttGs2200::reset_stats()
+{
+  memset(&mStats, 0, sizeof(mStats));
+}
+
 bool MqttGs2200::subscribe(MQTTGS2200_Mqtt* mqtt)
 {
   ATCMD_RESP_E resp = ATCMD_RESP_UNMATCH;
@@ -108,6 +296,78 @@ bool MqttGs2200::subscribe(MQTTGS2200_Mqtt* mqtt)
   return result;
 }
 
+/*
+ * Subscribe to a topic filter (+ and # wildcards allowed) and call the
+ * callback with the messages that match it. Messages are parsed straight
+ * from the receive buffer while poll() runs, without String allocation.
+ */
+bool MqttGs2200::subscribe(const char* filter, MQTTGS2200_Callback callback, uint8_t qos)
+{
+  if (mSubCount >= MQTTGS2200_MAX_SUBSCRIPTIONS) {
+    return false;
+  }
+
+  if (ATCMD_RESP_OK != AtCmd_MQTTSUBSCRIBE(mCid, filter, qos)) {
+    return false;
+  }
+
+  mSubs[mSubCount].filter = filter;
+  mSubs[mSubCount].callback = callback;
+  mSubs[mSubCount].qos = qos;
+  mSubCount++;
+
+  AtCmd_SetMQTTHandler(dispatch, this);
+  return true;
+}
+
+void MqttGs2200::dispatch(char cid, const char* topic, const uint8_t* data, uint16_t length, uint32_t offset, uint32_t total, void* arg)
+{
+  MqttGs2200* self = (MqttGs2200*)arg;
+
+  if (cid != self->mCid) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < self->mSubCount; i++) {
+    if (topic_match(self->mSubs[i].filter, topic)) {
+      self->mSubs[i].callback(topic, data, length, offset, total);
+    }
+  }
+}
+
+/*
+ * MQTT topic filter matching, '+' matches one level and '#' the rest
+ */
+bool MqttGs2200::topic_match(const char* filter, const char* topic)
+{
+  /* Wildcards do not match the $SYS style topics */
+  if (topic[0] == '$' && (filter[0] == '+' || filter[0] == '#')) {
+    return false;
+  }
+
+  while (*filter) {
+    if (*filter == '#') {
+      return true;
+    }
+
+    if (*filter == '+') {
+      while (*topic && *topic != '/') {
+        topic++;
+      }
+      filter++;
+    } else {
+      if (*filter != *topic) {
+        /* "a/#" matches "a" as well */
+        return (*topic == '\0' && !strcmp(filter, "/#"));
+      }
+      filter++;
+      topic++;
+    }
+  }
+
+  return (*topic == '\0');
+}
+
 bool MqttGs2200::receive(String& data)
 {
   ATCMD_RESP_E resp = ATCMD_RESP_UNMATCH;
@@ -115,6 +375,7 @@ bool MqttGs2200::receive(String& data)
 
   resp = AtCmd_RecieveMQTTData(data);
   if (ATCMD_RESP_DISCONNECT == resp) {
+    mConnected = false;
     result = false;
   } else {
     result = true;
@@ -130,6 +391,7 @@ bool MqttGs2200::stop()
 
   ConsolePrintf("stop %d\n", mCid);
   resp = AtCmd_NCLOSE(mCid);
+  mConnected = false;
   if (ATCMD_RESP_OK == resp) {
     result = true;
   } else {
@@ -24,6 +24,7 @@
 #include <GS2200Hal.h>
 #include <GS2200AtCmd.h>
 #include <TelitWiFi.h>
+#include <OfflineQueueGs2200.h>
 
 
 typedef struct {
@@ -38,26 +39,85 @@ typedef struct {
   ATCMD_MQTTparams params;
 } MQTTGS2200_Mqtt;
 
+#define MQTTGS2200_RECONNECT_MIN   1000   /* first reconnect interval (ms) */
+#define MQTTGS2200_RECONNECT_MAX  30000   /* reconnect interval limit (ms) */
+
+typedef struct {
+  uint32_t published;   /* messages accepted by GS2200 */
+  uint32_t failed;      /* publish attempts that failed */
+  uint32_t reconnects;  /* successful reconnections */
+  uint32_t elapsed;     /* milliseconds from the first publish */
+  uint32_t rate;        /* messages per second */
+} MQTTGS2200_Stats;
+
+#define MQTTGS2200_MAX_SUBSCRIPTIONS 16
+
+/* Receives a message payload in fragments, offset/total locate the fragment in the message */
+typedef void (*MQTTGS2200_Callback)(const char* topic, const uint8_t* data, uint16_t length, uint32_t offset, uint32_t total);
+
+typedef struct {
+  const char* filter;            /* not copied, must stay valid */
+  MQTTGS2200_Callback callback;
+  uint8_t qos;
+} MQTTGS2200_Subscription;
+
 class MqttGs2200
 {
 public:
 
-  MqttGs2200(TelitWiFi* wifi) : mWifi(wifi) {}
-  ~MqttGs2200(){}
+  MqttGs2200(TelitWiFi* wifi) : mWifi(wifi), mCid(ATCMD_INVALID_CID), mPersistent(false), mConnected(false),
+                                mReconnectAt(0), mReconnectWait(MQTTGS2200_RECONNECT_MIN), mStatsStart(0),
+                                mSubCount(0), mQueue(NULL) { reset_stats(); }
+  ~MqttGs2200(){ end(); }
 
   bool begin(MQTTGS2200_HostParams* params);
   bool connect();
   bool publish(MQTTGS2200_Mqtt* mqtt);
+  bool publish(const char* topic, const void* data, uint32_t length, uint8_t qos = 0, bool retain = false);
   bool subscribe(MQTTGS2200_Mqtt* mqtt);
   bool receive(String& data);
   bool MqttGs2200::stop();
-  void end(){ }
+  void end();
+
+  /* Persistent session: keep the connection open between publishes */
+  void set_persistent(bool enable);
+  bool connected();
+  bool poll();
+  void get_stats(MQTTGS2200_Stats* stats);
+  void reset_stats();
+
+  /* Subscription with a callback, messages are dispatched from poll() */
+  bool subscribe(const char* filter, MQTTGS2200_Callback callback, uint8_t qos = 0);
+  static bool topic_match(const char* filter, const char* topic);
+
+  /* Store-and-forward: messages that cannot be sent are queued and sent later in order */
+  void set_offline_queue(OfflineQueueGs2200* queue);
+  uint32_t flush();
 
 private:
 
+  bool send(const char* topic, const void* data, uint32_t length, uint8_t qos, bool retain);
+  void process_events();
+  static void on_event(ATCMD_RESP_E event, char cid, void* arg);
+  bool reconnect();
+  static void dispatch(char cid, const char* topic, const uint8_t* data, uint16_t length, uint32_t offset, uint32_t total, void* arg);
+  static bool send_queued(const OFFLINEQUEUE_Record* rec, const char* topic, const uint8_t* data, void* arg);
+
   TelitWiFi* mWifi;
   char mCid;
 
+  bool mPersistent;
+  bool mConnected;
+  uint32_t mReconnectAt;
+  uint32_t mReconnectWait;
+  uint32_t mStatsStart;
+  MQTTGS2200_Stats mStats;
+
+  MQTTGS2200_Subscription mSubs[MQTTGS2200_MAX_SUBSCRIPTIONS];
+  uint8_t mSubCount;
+
+  OfflineQueueGs2200* mQueue;
+
   MQTTGS2200_HostParams mData;
 
 };
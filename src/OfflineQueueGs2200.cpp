@@ -0,0 +1,350 @@
+/*
+ *  Offline Queue Library for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "OfflineQueueGs2200.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Records are kept in the RAM ring first. Once it is full, new records are
+ * appended to the spill file and keep going there until the file is drained,
+ * so everything in RAM is always older than everything in the file and the
+ * order is kept. The file header has the offset of the oldest record not
+ * sent yet, records before it are not sent again after a reset.
+ */
+
+OfflineQueueGs2200::OfflineQueueGs2200()
+  : mHead(0), mUsed(0), mRamCount(0),
+    mSpillPath(NULL), mSpillMax(0), mSpillRead(0), mSpillSize(0), mSpillCount(0),
+    mCount(0), mNextSeq(1)
+{
+  memset(&mStats, 0, sizeof(mStats));
+}
+
+bool OfflineQueueGs2200::set_spill(const char* path, uint32_t maxSize)
+{
+#ifndef SUBCORE
+  OFFLINEQUEUE_Record rec;
+  uint32_t pos = OFFLINEQUEUE_SPILL_HEADER;
+  uint32_t next, size;
+  int fd;
+
+  mSpillPath = path;
+  mSpillMax = maxSize;
+  mSpillRead = 0;
+  mSpillSize = 0;
+  mSpillCount = 0;
+
+  /* Recover the records left by the previous run */
+  File f(path, FILE_READ);
+  if (!f) {
+    return true;
+  }
+
+  size = f.size();
+  if (f.read(&mSpillRead, sizeof(mSpillRead)) != sizeof(mSpillRead) ||
+      mSpillRead < OFFLINEQUEUE_SPILL_HEADER || mSpillRead > size) {
+    f.close();
+    mSpillRead = 0;
+    unlink(path);
+    return true;
+  }
+
+  /* Sent records are read for their sequence numbers only */
+  while (f.read(&rec, sizeof(rec)) == sizeof(rec)) {
+    next = pos + sizeof(rec) + rec.keyLen + rec.dataLen;
+    if (rec.keyLen + rec.dataLen > OFFLINEQUEUE_RECORD_MAX || next > size) {
+      break;
+    }
+    if (pos >= mSpillRead) {
+      mSpillCount++;
+    }
+    if (rec.seq >= mNextSeq) {
+      mNextSeq = rec.seq + 1;
+    }
+    pos = next;
+    f.seek(pos);
+  }
+  f.close();
+
+  if (!mSpillCount) {
+    mSpillRead = 0;
+    unlink(path);
+    return true;
+  }
+
+  mSpillSize = pos;
+  if (mSpillSize < size) {
+    /* The last record was torn by the reset, new ones go in its place */
+    ConsoleLog("Offline queue: torn record discarded");
+    if ((fd = open(path, O_WRONLY)) >= 0) {
+      ftruncate(fd, mSpillSize);
+      close(fd);
+    }
+  }
+
+  mCount += mSpillCount;
+  ConsolePrintf("Offline queue: %d records recovered\r\n", mSpillCount);
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint32_t OfflineQueueGs2200::push(const char* key, const void* data, uint16_t length, uint8_t flags, uint32_t seq)
+{
+  OFFLINEQUEUE_Record rec, old;
+  uint16_t keyLen = key ? strlen(key) : 0;
+  uint16_t size;
+
+  if (keyLen > 255 || keyLen + length > OFFLINEQUEUE_RECORD_MAX) {
+    return 0;
+  }
+
+  if (seq) {
+    /* A sample we already have, e.g. re-queued after a reset */
+    if (seq < mNextSeq) {
+      mStats.duplicates++;
+      return 0;
+    }
+  } else {
+    seq = mNextSeq;
+  }
+
+  rec.seq = seq;
+  rec.time = millis();
+  rec.dataLen = length;
+  rec.keyLen = keyLen;
+  rec.flags = flags;
+  size = sizeof(rec) + keyLen + length;
+
+  if (!mSpillCount && (OFFLINEQUEUE_RAM_SIZE - mUsed) < size && !mSpillPath) {
+    /* No file, make room by dropping the oldest records */
+    while ((OFFLINEQUEUE_RAM_SIZE - mUsed) < size && peek(&old)) {
+      pop(&old);
+      mStats.dropped++;
+    }
+  }
+
+  if (!mSpillCount && (OFFLINEQUEUE_RAM_SIZE - mUsed) >= size) {
+    ring_write(&rec, sizeof(rec));
+    ring_write(key, keyLen);
+    ring_write(data, length);
+    mRamCount++;
+  } else if (!spill(&rec, key, data)) {
+    return 0;
+  }
+
+  mCount++;
+  mNextSeq = seq + 1;
+  return seq;
+}
+
+uint32_t OfflineQueueGs2200::drain(OFFLINEQUEUE_Sender sender, void* arg, uint32_t max)
+{
+  OFFLINEQUEUE_Record rec;
+  uint32_t sent = 0;
+
+  while ((!max || sent < max) && peek(&rec)) {
+    /* mScratch holds the key, a terminating NULL and the data */
+    if (!sender(&rec, (const char*)mScratch, mScratch + rec.keyLen + 1, arg)) {
+      break;
+    }
+    pop(&rec);
+    mStats.sent++;
+    sent++;
+  }
+
+  return sent;
+}
+
+void OfflineQueueGs2200::get_stats(OFFLINEQUEUE_Stats* stats)
+{
+  OFFLINEQUEUE_Record rec;
+
+  mStats.queued = mCount;
+  mStats.bytes = mUsed + (mSpillSize - mSpillRead);
+  mStats.oldest = peek(&rec) ? msDelta(rec.time) : 0;
+  *stats = mStats;
+}
+
+/*
+ * Read the oldest record into mScratch
+ */
+bool OfflineQueueGs2200::peek(OFFLINEQUEUE_Record* rec)
+{
+  if (mRamCount) {
+    ring_read(0, rec, sizeof(*rec));
+    ring_read(sizeof(*rec), mScratch, rec->keyLen);
+    mScratch[rec->keyLen] = '\0';
+    ring_read(sizeof(*rec) + rec->keyLen, mScratch + rec->keyLen + 1, rec->dataLen);
+    return true;
+  }
+
+#ifndef SUBCORE
+  if (mSpillCount) {
+    File f(mSpillPath, FILE_READ);
+    if (f && f.seek(mSpillRead) &&
+        f.read(rec, sizeof(*rec)) == sizeof(*rec) &&
+        rec->keyLen + rec->dataLen <= OFFLINEQUEUE_RECORD_MAX &&
+        f.read(mScratch, rec->keyLen) == rec->keyLen &&
+        f.read(mScratch + rec->keyLen + 1, rec->dataLen) == rec->dataLen) {
+      mScratch[rec->keyLen] = '\0';
+      f.close();
+      return true;
+    }
+    if (f) {
+      f.close();
+    }
+
+    /* Broken file, nothing after this point can be trusted */
+    ConsoleLog("Offline queue: spill file broken, discarded");
+    mStats.dropped += mSpillCount;
+    mCount -= mSpillCount;
+    mSpillCount = 0;
+    mSpillRead = mSpillSize = 0;
+    unlink(mSpillPath);
+  }
+#endif
+
+  return false;
+}
+
+void OfflineQueueGs2200::pop(const OFFLINEQUEUE_Record* rec)
+{
+  uint16_t size = sizeof(*rec) + rec->keyLen + rec->dataLen;
+
+  if (mRamCount) {
+    mHead = (mHead + size) % OFFLINEQUEUE_RAM_SIZE;
+    mUsed -= size;
+    mRamCount--;
+  } else {
+    mSpillRead += size;
+    mSpillCount--;
+    if (!mSpillCount) {
+      /* Drained, start over with an empty file */
+      mSpillRead = mSpillSize = 0;
+      unlink(mSpillPath);
+    } else {
+      spill_save();
+    }
+  }
+  mCount--;
+}
+
+/*
+ * Write mSpillRead over the file header
+ */
+void OfflineQueueGs2200::spill_save()
+{
+#ifndef SUBCORE
+  int fd = open(mSpillPath, O_WRONLY);
+
+  if (fd < 0) {
+    return;
+  }
+  if (write(fd, &mSpillRead, sizeof(mSpillRead)) != sizeof(mSpillRead)) {
+    ConsoleLog("Offline queue: read offset not saved");
+  }
+  close(fd);
+#endif
+}
+
+bool OfflineQueueGs2200::spill(const OFFLINEQUEUE_Record* rec, const char* key, const void* data)
+{
+#ifndef SUBCORE
+  OFFLINEQUEUE_Record old;
+  uint32_t size = sizeof(*rec) + rec->keyLen + rec->dataLen;
+  uint32_t dropped = mStats.dropped;
+  int fd;
+
+  if (!mSpillPath) {
+    return false;
+  }
+
+  /* Bound the backlog in the file by dropping its oldest records */
+  while (mSpillCount && (mSpillSize - mSpillRead) + size > mSpillMax) {
+    File f(mSpillPath, FILE_READ);
+    if (!f || !f.seek(mSpillRead) || f.read(&old, sizeof(old)) != sizeof(old)) {
+      return false;
+    }
+    f.close();
+    mSpillRead += sizeof(old) + old.keyLen + old.dataLen;
+    mSpillCount--;
+    mCount--;
+    mStats.dropped++;
+  }
+  if (dropped != mStats.dropped) {
+    spill_save();
+  }
+
+  File f(mSpillPath, FILE_WRITE);
+  if (!f) {
+    return false;
+  }
+  if (!mSpillSize) {
+    /* New file */
+    mSpillRead = mSpillSize = OFFLINEQUEUE_SPILL_HEADER;
+    if (f.write((const uint8_t*)&mSpillRead, sizeof(mSpillRead)) != sizeof(mSpillRead)) {
+      f.close();
+      mSpillRead = mSpillSize = 0;
+      unlink(mSpillPath);
+      return false;
+    }
+  }
+  if (f.write((const uint8_t*)rec, sizeof(*rec)) != sizeof(*rec) ||
+      f.write((const uint8_t*)key, rec->keyLen) != rec->keyLen ||
+      f.write((const uint8_t*)data, rec->dataLen) != rec->dataLen) {
+    f.close();
+    /* The next record must not follow a partial one */
+    if ((fd = open(mSpillPath, O_WRONLY)) >= 0) {
+      ftruncate(fd, mSpillSize);
+      close(fd);
+    }
+    return false;
+  }
+  f.close();
+
+  mSpillSize += size;
+  mSpillCount++;
+  mStats.spilled++;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void OfflineQueueGs2200::ring_write(const void* src, uint16_t len)
+{
+  uint16_t tail = (mHead + mUsed) % OFFLINEQUEUE_RAM_SIZE;
+  uint16_t first = min((int)len, OFFLINEQUEUE_RAM_SIZE - tail);
+
+  memcpy(mRing + tail, src, first);
+  memcpy(mRing, (const uint8_t*)src + first, len - first);
+  mUsed += len;
+}
+
+void OfflineQueueGs2200::ring_read(uint16_t pos, void* dst, uint16_t len)
+{
+  uint16_t start = (mHead + pos) % OFFLINEQUEUE_RAM_SIZE;
+  uint16_t first = min((int)len, OFFLINEQUEUE_RAM_SIZE - start);
+
+  memcpy(dst, mRing + start, first);
+  memcpy((uint8_t*)dst + first, mRing, len - first);
+}
@@ -0,0 +1,98 @@
+/*
+ *  Offline Queue Library for GS2200
+ *  Copyright 2026 Spresense Users
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef OFFLINE_QUEUE_GS2200_h
+#define OFFLINE_QUEUE_GS2200_h
+
+#include <Arduino.h>
+#include <File.h>
+#include <GS2200Hal.h>
+
+#define OFFLINEQUEUE_RAM_SIZE      4096      /* bytes of the RAM ring */
+#define OFFLINEQUEUE_RECORD_MAX     512      /* key + data of one record */
+#define OFFLINEQUEUE_SPILL_MAX   (1024 * 1024) /* default limit of the spill file */
+#define OFFLINEQUEUE_SPILL_HEADER   4        /* offset of the oldest record not sent, at the start of the file */
+
+/* Record header, followed by the key and the data */
+typedef struct {
+  uint32_t seq;       /* sequence number, increases by one per record */
+  uint32_t time;      /* millis() when queued */
+  uint16_t dataLen;
+  uint8_t  keyLen;
+  uint8_t  flags;     /* free for the user, e.g. QoS/retain */
+} OFFLINEQUEUE_Record;
+
+typedef struct {
+  uint32_t queued;      /* records waiting */
+  uint32_t bytes;       /* bytes waiting, RAM and file */
+  uint32_t spilled;     /* records written to the file */
+  uint32_t sent;        /* records drained */
+  uint32_t dropped;     /* oldest records dropped because the queue was full */
+  uint32_t duplicates;  /* records refused by their sequence number */
+  uint32_t oldest;      /* age of the oldest record (ms) */
+} OFFLINEQUEUE_Stats;
+
+/* Sends one record, returns false to stop draining and keep the record */
+typedef bool (*OFFLINEQUEUE_Sender)(const OFFLINEQUEUE_Record* rec, const char* key, const uint8_t* data, void* arg);
+
+class OfflineQueueGs2200
+{
+public:
+
+  OfflineQueueGs2200();
+  ~OfflineQueueGs2200(){}
+
+  /* Records that do not fit in RAM go to this file, records left there by a previous run are recovered */
+  bool set_spill(const char* path, uint32_t maxSize = OFFLINEQUEUE_SPILL_MAX);
+
+  /* Returns the sequence number, 0 if refused. seq = 0 numbers the record automatically */
+  uint32_t push(const char* key, const void* data, uint16_t length, uint8_t flags = 0, uint32_t seq = 0);
+  uint32_t drain(OFFLINEQUEUE_Sender sender, void* arg, uint32_t max = 0);
+
+  bool empty() { return (mCount == 0); }
+  uint32_t count() { return mCount; }
+  void get_stats(OFFLINEQUEUE_Stats* stats);
+
+private:
+
+  bool peek(OFFLINEQUEUE_Record* rec);
+  void pop(const OFFLINEQUEUE_Record* rec);
+  void ring_write(const void* src, uint16_t len);
+  void ring_read(uint16_t pos, void* dst, uint16_t len);
+  bool spill(const OFFLINEQUEUE_Record* rec, const char* key, const void* data);
+  void spill_save();
+
+  uint8_t  mRing[OFFLINEQUEUE_RAM_SIZE];
+  uint16_t mHead;       /* oldest byte */
+  uint16_t mUsed;
+  uint32_t mRamCount;
+
+  const char* mSpillPath;
+  uint32_t mSpillMax;
+  uint32_t mSpillRead;  /* offset of the oldest record in the file, kept in its header */
+  uint32_t mSpillSize;  /* end of the last whole record */
+  uint32_t mSpillCount;
+
+  uint32_t mCount;
+  uint32_t mNextSeq;
+  uint8_t  mScratch[OFFLINEQUEUE_RECORD_MAX + 1];
+  OFFLINEQUEUE_Stats mStats;
+};
+
+#endif // OFFLINE_QUEUE_GS2200_h
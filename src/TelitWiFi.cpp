@@ -30,18 +30,130 @@ extern uint32_t ESCBufferCnt;
 #define gs2200_printf(...) do {} while (0)
 #endif
 
+typedef struct {
+	ATCMD_SOCKET_OPTION_TYPE_E  type;
+	ATCMD_SOCKET_OPTION_PARAM_E param;
+	uint32_t value;
+} TWIFI_SockOpt;
+
+/* Socket options of each profile, terminated by ATCMD_SOCKOPT_TYPE_UNKNOWN */
+static const TWIFI_SockOpt SockOptBulk[] = {
+	{ ATCMD_SOCKOPT_TYPE_SOCKET, ATCMD_SOCKOPT_PARAM_SO_RCVBUF,           65535 },
+	{ ATCMD_SOCKOPT_TYPE_TCP,    ATCMD_SOCKOPT_PARAM_TCP_MAX_TX_Q_DEPTH,  8     },
+	{ ATCMD_SOCKOPT_TYPE_UNKNOWN, ATCMD_SOCKOPT_PARAM_UNKNOWN, 0 }
+};
+
+static const TWIFI_SockOpt SockOptLowLatency[] = {
+	{ ATCMD_SOCKOPT_TYPE_TCP,    ATCMD_SOCKOPT_PARAM_TCP_REX_TIMER_RATE,  100   },
+	{ ATCMD_SOCKOPT_TYPE_TCP,    ATCMD_SOCKOPT_PARAM_TCP_MAX_REXMIT,      4     },
+	{ ATCMD_SOCKOPT_TYPE_IP,     ATCMD_SOCKOPT_PARAM_IP_DSCP,             46    }, /* EF */
+	{ ATCMD_SOCKOPT_TYPE_UNKNOWN, ATCMD_SOCKOPT_PARAM_UNKNOWN, 0 }
+};
+
+static const TWIFI_SockOpt SockOptKeepAlive[] = {
+	{ ATCMD_SOCKOPT_TYPE_TCP,    ATCMD_SOCKOPT_PARAM_TCP_KEEPALIVE,       60    }, /* seconds */
+	{ ATCMD_SOCKOPT_TYPE_TCP,    ATCMD_SOCKOPT_PARAM_TCP_MAXRT,           30    },
+	{ ATCMD_SOCKOPT_TYPE_UNKNOWN, ATCMD_SOCKOPT_PARAM_UNKNOWN, 0 }
+};
+
+/**
+ * @brief Bit of a CID in mCoalesceCids, 0 for an invalid CID
+ */
+static uint16_t cid_bit(char cid)
+{
+	int idx = AtCmd_CidIndex( cid );
+
+	return ( idx < 0 ) ? 0 : 1 << idx;
+}
+
+
 TelitWiFi::TelitWiFi()
+	: mSockProfile(TWIFI_SOCKPROF_DEFAULT),
+	  mBatch(NULL), mBatchLen(0), mBatchCount(0), mBatchOldest(0), mBatchDeadline(0), mBatchStart(0), mBatchCid(ATCMD_INVALID_CID),
+	  mFastResume(false), mResumed(false), mBootStart(0), mBootProfile(false), mFirstPacket(0),
+	  mLinkState(TWIFI_LINK_OFF), mReopenHandler(NULL), mReopenArg(NULL),
+	  mLinkCheck(0), mLinkLost(0), mBackoff(TWIFI_BACKOFF_MIN), mLinkCheckDue(false),
+	  mRecoverStep(0), mRecoverNext(0), mRecoverStart(0),
+	  mPark(NULL), mParkLen(0), mParkFrame(0), mParkCount(0), mParkOpen(false), mParkDiscard(false),
+	  mCoalesceCids(0), mCoalesceThreshold(ATCMD_BULK_MAX_SIZE), mCoalesceDelay(TWIFI_COALESCE_DELAY)
 {
+	memset( &mTxStats, 0, sizeof(mTxStats) );
+	memset( &mBatchStats, 0, sizeof(mBatchStats) );
+	memset( &mCoalesceStats, 0, sizeof(mCoalesceStats) );
+	memset( &mAcceptStats, 0, sizeof(mAcceptStats) );
+	memset( &mBootReport, 0, sizeof(mBootReport) );
+	memset( &mLinkStats, 0, sizeof(mLinkStats) );
+	memset( mFlow, 0, sizeof(mFlow) );
+	memset( mListeners, 0, sizeof(mListeners) );
+	mSsid[0] = mPassphrase[0] = '\0';
+	for( int i = 0; i < TWIFI_REOPEN_NUM; i++ ){
+		mReopen[i].used = false;
+		mReopen[i].cid = ATCMD_INVALID_CID;
+	}
+	for( int i = 0; i < TWIFI_SOCKET_NUM; i++ ){
+		mSockets[i].cid = ATCMD_INVALID_CID;
+		mSockets[i].rx = NULL;
+	}
+	for( int i = 0; i < TWIFI_COALESCE_NUM; i++ ){
+		mTxBuffers[i].cid = ATCMD_INVALID_CID;
+		mTxBuffers[i].data = NULL;
+	}
 }
 
+/* The buffers of sockets, coalescing, batching and the park are taken from
+   the heap when a feature is first used, a sketch pays only for what it uses */
 TelitWiFi::~TelitWiFi()
 {
+	for( int i = 0; i < TWIFI_SOCKET_NUM; i++ )
+		free( mSockets[i].rx );
+	for( int i = 0; i < TWIFI_COALESCE_NUM; i++ )
+		free( mTxBuffers[i].data );
+	free( mBatch );
+	free( mPark );
 }
 
+/* Steps of begin() in order */
+enum {
+	BOOT_AT = 0,
+	BOOT_ATE,
+	BOOT_PROFILE_Q,
+	BOOT_REGDOMAIN,
+	BOOT_NMAC,
+	BOOT_VER,
+	BOOT_WRXACTIVE,
+	BOOT_WRXPS,
+	BOOT_WM,
+	BOOT_WSEC,
+	BOOT_NDHCP,
+	BOOT_DHCPSRVR,
+	BOOT_BDATA,
+	BOOT_PROFILE_SAVE,
+	BOOT_PROFILE_DEFAULT
+};
+
+/* Steps of the reassociation by supervise(), one per call */
+enum {
+	RECOVER_WD = 0,
+	RECOVER_NDHCP,
+	RECOVER_WPAPSK,
+	RECOVER_WA,
+	RECOVER_NSTAT,
+	RECOVER_REOPEN
+};
+
+static const char* const BootStepName[TWIFI_BOOT_STEP_NUM] = {
+	"AT", "ATE0", "AT&V", "WREGDOMAIN", "NMAC", "VER", "WRXACTIVE", "WRXPS",
+	"WM", "WSEC", "NDHCP", "DHCPSRVR", "BDATA", "AT&W0", "AT&Y0"
+};
+
+/* Active profile read by AT&V, empty if not read */
+static char BootProfile[TWIFI_PROFILE_SIZE];
+
 /***
  * @brief Initialize GS2000 Module before associating to AP(Access Point)
  *        Set following parameters of AT commands
  *        AT+WM, AT+WRXACIVE
+ *        A step that fails is sent again, the ones before it are not.
  * @param params - IN: WiFi parameters
  * @return 0: success, -1: failure
  *          
@@ -49,9 +161,17 @@ TelitWiFi::~TelitWiFi()
 int TelitWiFi::begin(TWIFI_Params params)
 {
 	ATCMD_RESP_E r = ATCMD_RESP_UNMATCH;
-	ATCMD_REGDOMAIN_E regDomain;
-	char macid[20];
+	TWIFI_BootStep *step;
 	uint32_t start = millis();
+	uint32_t t;
+	bool save = false;
+	int match;
+
+	mBootStart = start;
+	mFirstPacket = 0;
+	mResumed = false;
+	memset( &mBootReport, 0, sizeof(mBootReport) );
+	BootProfile[0] = '\0';
 
 	/* Try to read boot-up banner */
 	while( Get_GPIO37Status() ){
@@ -60,77 +180,214 @@ int TelitWiFi::begin(TWIFI_Params params)
 			ConsoleLog("Normal Boot.\r\n");
 	}
 
-	while( 1 ){
+	for( uint8_t i = 0; i < TWIFI_BOOT_STEP_NUM; i++ ){
+		step = &mBootReport.step[i];
+		step->name = BootStepName[i];
+
+		match = boot_check( i, params );
+		if( match > 0 || !boot_needed( i, params, save ) )
+			continue;
+		if( !match && BOOT_REGDOMAIN != i )
+			save = true;
+
+		t = millis();
+		do{
+			if( msDelta( start ) >= CMD_TIMEOUT ){
+				mBootReport.total = msDelta( start );
+				return FAIL;
+			}
+			r = boot_command( i, params );
+			step->tries++;
+		}while( ATCMD_RESP_OK != r &&
+		        !( ( BOOT_PROFILE_Q == i || BOOT_PROFILE_SAVE <= i ) && step->tries == TWIFI_BOOT_RETRY ) );
+		step->ms = msDelta( t );
+
+		if( BOOT_PROFILE_Q == i && BootProfile[0] ){
+			/* Verified if a setting was found and none differs */
+			int found = 0;
+			mBootReport.verified = true;
+			for( uint8_t j = i + 1; j < TWIFI_BOOT_STEP_NUM; j++ ){
+				int c = boot_check( j, params );
+				if( !c )
+					mBootReport.verified = false;
+				else if( 0 < c )
+					found++;
+			}
+			if( !found )
+				mBootReport.verified = false;
+		}
+		if( BOOT_PROFILE_SAVE == i && ATCMD_RESP_OK == r )
+			mBootReport.saved = true;
+	}
 
-		if( msDelta( start ) >= CMD_TIMEOUT )
-			return FAIL;
+	mBootReport.total = msDelta( start );
+	return OK;
+}
 
-		r = AtCmd_AT();
-		if( ATCMD_RESP_OK != r ) continue;
+/**
+ * @brief Is the step sent in this begin()
+ * @param bool save - IN: a setting in the profile differs
+ */
+bool TelitWiFi::boot_needed(uint8_t step, const TWIFI_Params& params, bool save)
+{
+	bool ap = ( ATCMD_MODE_LIMITED_AP == params.mode );
+
+	switch( step ){
+	case BOOT_PROFILE_Q:
+		return mBootProfile;
+	case BOOT_REGDOMAIN:
+		/* Kept in flash apart from the profile, skipped only when read back */
+		return true;
+	case BOOT_NMAC:
+	case BOOT_VER:
+		/* For the log only */
+		return !mBootProfile;
+	case BOOT_WSEC:
+	case BOOT_DHCPSRVR:
+		return ap;
+	case BOOT_PROFILE_SAVE:
+	case BOOT_PROFILE_DEFAULT:
+		return mBootProfile && save;
+	default:
+		return true;
+	}
+}
+
+/**
+ * @brief Compare a setting with the active profile
+ * @return 1: same, 0: differs, -1: not in the profile or not checked
+ */
+int TelitWiFi::boot_check(uint8_t step, const TWIFI_Params& params)
+{
+	bool ap = ( ATCMD_MODE_LIMITED_AP == params.mode );
+	const char *key;
+	const char *p;
+	int value;
+
+	switch( step ){
+	case BOOT_REGDOMAIN: key = " +WREGDOMAIN="; value = ATCMD_REGDOMAIN_TELEC; break;
+	case BOOT_WRXACTIVE: key = " +WRXACTIVE="; value = params.psave;      break;
+	case BOOT_WRXPS:     key = " +WRXPS=";     value = 1;                 break;
+	case BOOT_WM:        key = " +WM=";        value = params.mode;       break;
+	case BOOT_WSEC:      key = " +WSEC=";      value = ATCMD_SEC_WPA2PSK; break;
+	case BOOT_NDHCP:     key = " +NDHCP=";     value = ap ? 0 : 1;        break;
+	case BOOT_DHCPSRVR:  key = " +DHCPSRVR=";  value = 1;                 break;
+	case BOOT_BDATA:     key = " +BDATA=";     value = 1;                 break;
+	default:
+		return -1;
+	}
+
+	if( !BootProfile[0] || !boot_needed( step, params, false ) )
+		return -1;
+
+	p = strstr( BootProfile, key );
+	if( !p || !isdigit( p[strlen( key )] ) )
+		return -1;
+
+	return ( atoi( p + strlen( key ) ) == value ) ? 1 : 0;
+}
+
+ATCMD_RESP_E TelitWiFi::boot_command(uint8_t step, const TWIFI_Params& params)
+{
+	ATCMD_RESP_E r;
+	ATCMD_REGDOMAIN_E regDomain;
+	char macid[20];
 
+	switch( step ){
+	case BOOT_AT:
+		return AtCmd_AT();
 
+	case BOOT_ATE:
 		/* Send command to disable Echo */
-		r = AtCmd_ATE(0);
-		if( ATCMD_RESP_OK != r ) continue;
+		return AtCmd_ATE(0);
+
+	case BOOT_PROFILE_Q:
+		return AtCmd_ATV( BootProfile, sizeof(BootProfile) );
 
+	case BOOT_REGDOMAIN:
 		/* AT+WREGDOMAIN=? should run after disabling Echo, otherwise the wrong domain is obtained. */
 		r = AtCmd_WREGDOMAIN_Q( &regDomain );
-		if( ATCMD_RESP_OK != r ) continue;
-
 		/* If TELEC is not selected */
-		if( regDomain != ATCMD_REGDOMAIN_TELEC ){
+		if( ATCMD_RESP_OK == r && regDomain != ATCMD_REGDOMAIN_TELEC )
 			r = AtCmd_WREGDOMAIN( ATCMD_REGDOMAIN_TELEC );
-			if( ATCMD_RESP_OK != r ) continue;
-		}
+		return r;
 
+	case BOOT_NMAC:
 		/* Read MAC Address */
-		r = AtCmd_NMAC_Q( macid );
-		if( ATCMD_RESP_OK != r ) continue;
+		return AtCmd_NMAC_Q( macid );
 
+	case BOOT_VER:
 		/* Read Version Information */
-		r = AtCmd_VER();
-		if( ATCMD_RESP_OK != r ) continue;
+		return AtCmd_VER();
 
+	case BOOT_WRXACTIVE:
 		/* Enable Power save mode */
 		/* AT+WRXACTIVE=0, AT+WRXPS=1 */
-		r = AtCmd_WRXACTIVE( params.psave );
-		if( ATCMD_RESP_OK != r ) continue;
+		return AtCmd_WRXACTIVE( params.psave );
 
-		r = AtCmd_WRXPS(1);
-		if( ATCMD_RESP_OK != r ) continue;
+	case BOOT_WRXPS:
+		return AtCmd_WRXPS(1);
 
+	case BOOT_WM:
 		/* Set Wireless mode */
-		r = AtCmd_WM( params.mode );
-		if( ATCMD_RESP_OK != r ) continue;
+		return AtCmd_WM( params.mode );
 
-		if( ATCMD_MODE_LIMITED_AP==params.mode ){
-			r = AtCmd_WSEC( ATCMD_SEC_WPA2PSK ); // WPA2-personal
-			if( ATCMD_RESP_OK != r ) continue;
-
-			/* Disable DHCP Client */
-			r = AtCmd_NDHCP( 0 );
-			if( ATCMD_RESP_OK != r ) continue;
-
-			/* Disable DHCP Server */
-			/* This is necessary, otherwise AT+DHCPSRVR=1 may return ERROR so that we need to run this loop again */
-			r = AtCmd_DHCPSRVR( 0 );
-			/* Enable DHCP Server */
-			r = AtCmd_DHCPSRVR( 1 );
-			if( ATCMD_RESP_OK != r ) continue;
-			
-		}
-		else{
-			/* Enable DHCP Client */
-			r = AtCmd_NDHCP( 1 );
-			if( ATCMD_RESP_OK != r ) continue;
-		}
-		
+	case BOOT_WSEC:
+		return AtCmd_WSEC( ATCMD_SEC_WPA2PSK ); // WPA2-personal
+
+	case BOOT_NDHCP:
+		/* Disable DHCP Client in Limited AP mode, enable it in Station mode */
+		return AtCmd_NDHCP( ( ATCMD_MODE_LIMITED_AP == params.mode ) ? 0 : 1 );
+
+	case BOOT_DHCPSRVR:
+		/* Disable DHCP Server */
+		/* This is necessary, otherwise AT+DHCPSRVR=1 may return ERROR so that we need to run this step again */
+		AtCmd_DHCPSRVR( 0 );
+		/* Enable DHCP Server */
+		return AtCmd_DHCPSRVR( 1 );
+
+	case BOOT_BDATA:
 		/* Bulk Data mode */
-		r = AtCmd_BDATA(1);
-		if( ATCMD_RESP_OK != r ) continue;
-	
-		return OK;
+		return AtCmd_BDATA(1);
+
+	case BOOT_PROFILE_SAVE:
+		return AtCmd_ATW(0);
+
+	case BOOT_PROFILE_DEFAULT:
+		return AtCmd_ATY(0);
+
+	default:
+		return ATCMD_RESP_OK;
+	}
+}
+
+/**
+ * @brief Enable/disable the boot profile
+ * @param bool enable - IN: true: save the configuration and check it at boot
+ */
+void TelitWiFi::set_boot_profile(bool enable)
+{
+	mBootProfile = enable;
+}
+
+/**
+ * @brief Timing of each step of the last begin()
+ * @param TWIFI_BootReport *report - OUT: report
+ */
+void TelitWiFi::get_boot_report(TWIFI_BootReport* report)
+{
+	*report = mBootReport;
+}
+
+void TelitWiFi::print_boot_report()
+{
+	for( uint8_t i = 0; i < TWIFI_BOOT_STEP_NUM; i++ ){
+		if( mBootReport.step[i].tries )
+			ConsolePrintf( "  %-10s %5d ms  %d %s\r\n", mBootReport.step[i].name, mBootReport.step[i].ms,
+			               mBootReport.step[i].tries, ( mBootReport.step[i].tries > 1 ) ? "tries" : "try" );
 	}
+	ConsolePrintf( "Boot: %d ms%s%s\r\n", mBootReport.total, mBootReport.verified ? ", profile verified" : "",
+	               mBootReport.saved ? ", profile saved" : "" );
 }
 
 /**
@@ -146,6 +403,12 @@ int TelitWiFi::activate_station(const String& ssid, const String& passphrase)
 
 	ConsoleLog("Associate to Access Point");
 
+	/* Kept for the reassociation by supervise() */
+	strncpy( mSsid, ssid.c_str(), sizeof(mSsid) - 1 );
+	mSsid[sizeof(mSsid) - 1] = '\0';
+	strncpy( mPassphrase, passphrase.c_str(), sizeof(mPassphrase) - 1 );
+	mPassphrase[sizeof(mPassphrase) - 1] = '\0';
+
 	while( 1 ){
 		if( msDelta( start ) >= 2*CMD_TIMEOUT )
 			return FAIL;
@@ -166,10 +429,433 @@ int TelitWiFi::activate_station(const String& ssid, const String& passphrase)
 		r = AtCmd_WA( String(ssid).c_str(), "", 0 );
 		if( ATCMD_RESP_OK != r ) continue;
 
+		/* Keep the context so that the next wake-up can skip the association */
+		if( mFastResume ){
+			if( ATCMD_RESP_OK != AtCmd_STORENWCONN() )
+				ConsoleLog( "Store network context fails" );
+		}
+
 		return OK;
 	}
 }
 
+/**
+ * @brief Enable/disable fast resume in Station mode
+ * @param bool enable - IN: true: store/restore the network context
+ */
+void TelitWiFi::set_fast_resume(bool enable)
+{
+	mFastResume = enable;
+}
+
+/**
+ * @brief Resume the association stored by AT+STORENWCONN
+ *        Fall back to the full association (activate_station) on failure
+ * @param const char *ssid - IN: AP SSID
+ *        const char *passphrase - IN: WPA2 Passphrase
+ * @return 0: success, -1: failure
+ */
+int TelitWiFi::resume_station(const String& ssid, const String& passphrase)
+{
+	ATCMD_RESP_E r;
+	ATCMD_NetworkStatus networkStatus;
+	uint32_t start = millis();
+
+	mResumed = false;
+
+	if( mFastResume ){
+		ConsoleLog( "Restore network context" );
+		r = AtCmd_RESTORENWCONN();
+		if( ATCMD_RESP_OK == r ){
+			r = AtCmd_NSTAT( &networkStatus );
+			if( ATCMD_RESP_OK == r && networkStatus.connected ){
+				mResumed = true;
+				ConsolePrintf( "Resumed in %d ms\r\n", msDelta( start ) );
+				return OK;
+			}
+		}
+		ConsoleLog( "No network context, full association" );
+	}
+
+	return activate_station( ssid, passphrase );
+}
+
+/**
+ * @brief Was the last association restored from the stored context?
+ */
+bool TelitWiFi::resumed()
+{
+	return mResumed;
+}
+
+/**
+ * @brief Time from begin() to the first packet
+ * @return milliseconds, 0: no packet yet
+ */
+uint32_t TelitWiFi::time_to_first_packet()
+{
+	return mFirstPacket;
+}
+
+/**
+ * @brief Record the first packet after begin()
+ */
+void TelitWiFi::first_packet()
+{
+	if( mFirstPacket )
+		return;
+
+	mFirstPacket = msDelta( mBootStart );
+	if( !mFirstPacket )
+		mFirstPacket = 1;
+	ConsolePrintf( "Time to first packet: %d ms%s\r\n", mFirstPacket, mResumed ? " (resumed)" : "" );
+}
+
+/**
+ * @brief Enable/disable the link supervisor, call after activate_station()
+ * @param bool enable - IN: true: supervise() watches the link
+ *        TWIFI_ReopenHandler handler - IN: told the new CID of each reopened socket
+ *        void *arg - IN: argument of the handler
+ */
+void TelitWiFi::set_supervisor(bool enable, TWIFI_ReopenHandler handler, void *arg)
+{
+	mReopenHandler = handler;
+	mReopenArg = arg;
+	mLinkState = enable ? TWIFI_LINK_UP : TWIFI_LINK_OFF;
+	mLinkCheck = millis();
+	mLinkCheckDue = false;
+	mBackoff = TWIFI_BACKOFF_MIN;
+	mRecoverStep = RECOVER_WD;
+}
+
+/**
+ * @brief Reopen this socket after an outage
+ * @param char cid: Channel ID open now
+ *        TWIFI_SocketType type - IN: how it was opened
+ *        const char *host - IN: server (clients)
+ *        const char *port - IN: port of the server, or the local port (servers)
+ *        const char *local - IN: source port (UDP client)
+ * @return false: no room
+ */
+bool TelitWiFi::supervise_socket(char cid, TWIFI_SocketType type, const char *host, const char *port, const char *local)
+{
+	TWIFI_Reopen *entry = NULL;
+
+	unsupervise_socket( cid );
+	for( int i = 0; !entry && i < TWIFI_REOPEN_NUM; i++ ){
+		if( !mReopen[i].used )
+			entry = &mReopen[i];
+	}
+	if( !entry || cid == ATCMD_INVALID_CID )
+		return false;
+
+	entry->used = true;
+	entry->closed = false;
+	entry->cid = cid;
+	entry->type = type;
+	strncpy( entry->host, host ? host : "", sizeof(entry->host) - 1 );
+	entry->host[sizeof(entry->host) - 1] = '\0';
+	strncpy( entry->port, port, sizeof(entry->port) - 1 );
+	entry->port[sizeof(entry->port) - 1] = '\0';
+	strncpy( entry->local, local ? local : "", sizeof(entry->local) - 1 );
+	entry->local[sizeof(entry->local) - 1] = '\0';
+	return true;
+}
+
+/**
+ * @brief Stop reopening this socket
+ * @param char cid: Channel ID open now, or the one before the outage if
+ *        it was not reopened yet
+ */
+void TelitWiFi::unsupervise_socket(char cid)
+{
+	TWIFI_Reopen *entry;
+
+	if( cid == ATCMD_INVALID_CID )
+		return;
+
+	for( int i = 0; i < TWIFI_REOPEN_NUM; i++ ){
+		entry = &mReopen[i];
+		if( entry->used && ( entry->closed ? entry->lost : entry->cid ) == cid ){
+			entry->used = false;
+			entry->cid = ATCMD_INVALID_CID;
+		}
+	}
+}
+
+/**
+ * @brief Run the link supervisor, call it often from the loop
+ *        While the link is up, events are read and AT+NSTAT is sent every
+ *        TWIFI_LINK_CHECK ms. When it is lost, a reassociation is tried
+ *        after a wait that doubles on each failure. Each call sends one
+ *        command of it or reopens one socket. Sockets that could not be
+ *        reopened are tried again with their own backoff.
+ * @return the state of the link
+ */
+TWIFI_LinkState TelitWiFi::supervise()
+{
+	ATCMD_NetworkStatus networkStatus;
+
+	pump();
+
+	switch( mLinkState ){
+	case TWIFI_LINK_UP:
+		if( reopen_retry() )
+			break;
+		if( !mLinkCheckDue && msDelta( mLinkCheck ) < TWIFI_LINK_CHECK )
+			break;
+
+		mLinkCheck = millis();
+		mLinkCheckDue = false;
+		if( ATCMD_RESP_OK == AtCmd_NSTAT( &networkStatus ) && !networkStatus.connected )
+			link_lost();
+		break;
+
+	case TWIFI_LINK_LOST:
+		/* The wait is before the first command of an attempt only */
+		if( RECOVER_WD == mRecoverStep && msDelta( mLinkCheck ) < mBackoff )
+			break;
+
+		if( link_recover() < 0 ){
+			mBackoff = ( mBackoff < TWIFI_BACKOFF_MAX / 2 ) ? mBackoff * 2 : TWIFI_BACKOFF_MAX;
+			ConsolePrintf( "Reassociation fails, next in %d ms\r\n", mBackoff );
+			mRecoverStep = RECOVER_WD;
+		}
+		mLinkCheck = millis();
+		break;
+
+	default:
+		break;
+	}
+
+	return mLinkState;
+}
+
+void TelitWiFi::get_link_stats(TWIFI_LinkStats* stats)
+{
+	*stats = mLinkStats;
+}
+
+/**
+ * @brief The link is gone with all its CIDs: their sockets, buffers and
+ *        parked frames are freed so that nothing is mixed with the CIDs
+ *        given after the reassociation
+ */
+void TelitWiFi::link_lost()
+{
+	TWIFI_Reopen *entry;
+	TWIFI_Socket *sock;
+
+	ConsoleLog( "Link lost" );
+
+	mLinkState = TWIFI_LINK_LOST;
+	mLinkLost = mLinkCheck = millis();
+	mBackoff = TWIFI_BACKOFF_MIN;
+	mRecoverStep = RECOVER_WD;
+	mLinkStats.outages++;
+
+	/* Registered sockets are attached again as they were */
+	for( int i = 0; i < TWIFI_REOPEN_NUM; i++ ){
+		entry = &mReopen[i];
+		if( !entry->used || entry->closed )
+			continue;
+		sock = find_socket( entry->cid );
+		entry->attached = ( sock != NULL );
+		entry->udp = sock && sock->udp;
+		entry->server = sock ? sock->server : ATCMD_INVALID_CID;
+		entry->coalesce = ( mCoalesceCids & cid_bit( entry->cid ) ) != 0;
+		entry->lost = entry->cid;
+		entry->cid = ATCMD_INVALID_CID;
+		entry->closed = true;
+	}
+
+	for( int i = 0; i < TWIFI_SOCKET_NUM; i++ ){
+		if( mSockets[i].cid == ATCMD_INVALID_CID )
+			continue;
+		AtCmd_SetBulkHandler( NULL, mSockets[i].cid, NULL );
+		mSockets[i].cid = ATCMD_INVALID_CID;
+	}
+	for( int i = 0; i < TWIFI_COALESCE_NUM; i++ )
+		mTxBuffers[i].cid = ATCMD_INVALID_CID;
+	mCoalesceCids = 0;
+	accept_clear();
+
+	for( int i = 0; i < ATCMD_MAX_CID; i++ ){
+		mFlow[i].stalled = false;
+		mFlow[i].stats.credit = 0;
+	}
+	mParkLen = mParkFrame = mParkCount = 0;
+	mParkOpen = mParkDiscard = false;
+}
+
+/**
+ * @brief Send the next command of the reassociation, or reopen the next
+ *        registered socket once the link is up
+ * @return 1: done, the link is up, 0: not done yet, -1: failure
+ */
+int TelitWiFi::link_recover()
+{
+	ATCMD_NetworkStatus networkStatus;
+	ATCMD_RESP_E r = ATCMD_RESP_OK;
+
+	switch( mRecoverStep ){
+	case RECOVER_WD:
+		mLinkStats.attempts++;
+		ConsolePrintf( "Reassociate, try %d\r\n", mLinkStats.attempts );
+		mRecoverStart = millis();
+		r = AtCmd_WD();
+		break;
+
+	case RECOVER_NDHCP:
+		r = AtCmd_NDHCP( 1 );
+		break;
+
+	case RECOVER_WPAPSK:
+		r = AtCmd_WPAPSK( mSsid, mPassphrase );
+		break;
+
+	case RECOVER_WA:
+		r = AtCmd_WA( mSsid, "", 0 );
+		break;
+
+	case RECOVER_NSTAT:
+		r = AtCmd_NSTAT( &networkStatus );
+		if( ATCMD_RESP_OK == r && !networkStatus.connected )
+			r = ATCMD_RESP_ERROR;
+		if( ATCMD_RESP_OK != r )
+			break;
+
+		if( mFastResume && ATCMD_RESP_OK != AtCmd_STORENWCONN() )
+			ConsoleLog( "Store network context fails" );
+
+		/* The old CIDs are dead, their numbers may be given again */
+		AtCmd_NCLOSEALL();
+		WiFi_InitESCBuffer();
+		mLinkStats.reopened = mLinkStats.reopenFailed = 0;
+		mRecoverNext = 0;
+		for( int i = 0; i < TWIFI_REOPEN_NUM; i++ )
+			mReopen[i].backoff = 0;
+		break;
+
+	case RECOVER_REOPEN:
+		while( mRecoverNext < TWIFI_REOPEN_NUM && !( mReopen[mRecoverNext].used && mReopen[mRecoverNext].closed ) )
+			mRecoverNext++;
+		if( mRecoverNext < TWIFI_REOPEN_NUM ){
+			reopen_entry( &mReopen[mRecoverNext++] );
+			return 0;
+		}
+		break;
+
+	default:
+		return -1;
+	}
+
+	if( ATCMD_RESP_OK != r )
+		return -1;
+	if( RECOVER_REOPEN != mRecoverStep ){
+		mRecoverStep++;
+		return 0;
+	}
+
+	mLinkState = TWIFI_LINK_UP;
+	mRecoverStep = RECOVER_WD;
+	mLinkStats.lastRecovery = msDelta( mRecoverStart );
+	mLinkStats.lastOutage = msDelta( mLinkLost );
+	mLinkStats.totalOutage += mLinkStats.lastOutage;
+	if( mLinkStats.maxOutage < mLinkStats.lastOutage )
+		mLinkStats.maxOutage = mLinkStats.lastOutage;
+
+	ConsolePrintf( "Link recovered: outage %d ms, recovery %d ms, %d sockets reopened, %d failed\r\n",
+	               mLinkStats.lastOutage, mLinkStats.lastRecovery, mLinkStats.reopened, mLinkStats.reopenFailed );
+	return 1;
+}
+
+/**
+ * @brief Open a registered socket again with one AT command, without the
+ *        waits of connect() and the others
+ * @return the new CID, ATCMD_INVALID_CID on failure
+ */
+char TelitWiFi::reopen(TWIFI_Reopen* entry)
+{
+	ATCMD_RESP_E r;
+	char cid = ATCMD_INVALID_CID;
+
+	switch( entry->type ){
+	case TWIFI_TCP_CLIENT:
+		r = AtCmd_NCTCP( entry->host, entry->port, &cid );
+		break;
+	case TWIFI_UDP_CLIENT:
+		r = AtCmd_NCUDP( entry->host, entry->port, entry->local, &cid );
+		break;
+	case TWIFI_TCP_SERVER:
+		r = AtCmd_NSTCP( entry->port, &cid );
+		break;
+	case TWIFI_UDP_SERVER:
+		r = AtCmd_NSUDP( entry->port, &cid );
+		break;
+	default:
+		return ATCMD_INVALID_CID;
+	}
+
+	if( ATCMD_RESP_OK != r )
+		return ATCMD_INVALID_CID;
+	if( cid != ATCMD_INVALID_CID && TWIFI_TCP_SERVER != entry->type )
+		apply_socket_profile( cid, mSockProfile, TWIFI_TCP_CLIENT == entry->type );
+	return cid;
+}
+
+/**
+ * @brief Try to reopen a closed entry once, it stays registered on failure
+ */
+void TelitWiFi::reopen_entry(TWIFI_Reopen* entry)
+{
+	char cid = reopen( entry );
+
+	entry->retry = millis();
+	if( cid == ATCMD_INVALID_CID ){
+		if( !entry->backoff ){
+			mLinkStats.reopenFailed++;
+			if( mReopenHandler )
+				mReopenHandler( entry->lost, ATCMD_INVALID_CID, mReopenArg );
+		}
+		entry->backoff = !entry->backoff ? TWIFI_BACKOFF_MIN :
+		                 ( entry->backoff < TWIFI_BACKOFF_MAX / 2 ) ? entry->backoff * 2 : TWIFI_BACKOFF_MAX;
+		return;
+	}
+
+	if( entry->backoff && mLinkStats.reopenFailed )
+		mLinkStats.reopenFailed--;
+	mLinkStats.reopened++;
+	entry->cid = cid;
+	entry->closed = false;
+	entry->backoff = 0;
+	if( entry->attached )
+		socket_attach( cid, entry->udp, entry->server );
+	if( entry->coalesce )
+		mCoalesceCids |= cid_bit( cid );
+
+	if( mReopenHandler )
+		mReopenHandler( entry->lost, cid, mReopenArg );
+}
+
+/**
+ * @brief Reopen one socket the recovery could not, when its backoff is over
+ * @return true: a reopening was tried
+ */
+bool TelitWiFi::reopen_retry()
+{
+	TWIFI_Reopen *entry;
+
+	for( int i = 0; i < TWIFI_REOPEN_NUM; i++ ){
+		entry = &mReopen[i];
+		if( entry->used && entry->closed && msDelta( entry->retry ) >= entry->backoff ){
+			reopen_entry( entry );
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
  * @brief Association to AP in Limited-AP mode
  * @param const char *ssid - IN: AP SSID
@@ -203,6 +889,53 @@ int TelitWiFi::activate_ap(const String& ssid, const String& passphrase, uint8_t
 	}
 }
 
+/**
+ * @brief Set the socket option profile for the following connections
+ * @param TWIFI_SocketProfile profile - IN: profile applied after connect/accept
+ */
+void TelitWiFi::set_socket_profile(TWIFI_SocketProfile profile)
+{
+	mSockProfile = profile;
+}
+
+/**
+ * @brief Apply a socket option profile by AT+NXSETSOCKOPT
+ * @param char cid - IN: Channel ID
+ *        TWIFI_SocketProfile profile - IN: profile
+ *        bool tcp - IN: false skips TCP level options (UDP socket)
+ * @return true: all options accepted, false: at least one option failed
+ */
+bool TelitWiFi::apply_socket_profile(char cid, TWIFI_SocketProfile profile, bool tcp)
+{
+	const TWIFI_SockOpt *opt;
+	bool result = true;
+
+	switch( profile ){
+	case TWIFI_SOCKPROF_BULK:
+		opt = SockOptBulk;
+		break;
+	case TWIFI_SOCKPROF_LOW_LATENCY:
+		opt = SockOptLowLatency;
+		break;
+	case TWIFI_SOCKPROF_KEEPALIVE:
+		opt = SockOptKeepAlive;
+		break;
+	default:
+		return true;
+	}
+
+	for( ; opt->type != ATCMD_SOCKOPT_TYPE_UNKNOWN; opt++ ){
+		if( !tcp && ATCMD_SOCKOPT_TYPE_TCP == opt->type )
+			continue;
+		if( ATCMD_RESP_OK != AtCmd_NXSETSOCKOPT( cid, opt->type, opt->param, opt->value, 4 ) ){
+			gs2200_printf( "Socket option %d fails\n", opt->param );
+			result = false;
+		}
+	}
+
+	return result;
+}
+
 /**
  * @brief Connect TCP server
  * @param const char *ip - IN: IP
@@ -237,6 +970,8 @@ char TelitWiFi::connect(const String& ip, const String& port)
 		resp = AtCmd_NSTAT(&networkStatus);
 	} while (ATCMD_RESP_OK != resp);
 
+	apply_socket_profile( cid, mSockProfile );
+
 	ConsoleLog( "Connected" );
 	ConsolePrintf("IP: %d.%d.%d.%d\r\n", 
 	              networkStatus.addr.ipv4[0], networkStatus.addr.ipv4[1], networkStatus.addr.ipv4[2], networkStatus.addr.ipv4[3]);
@@ -294,6 +1029,7 @@ bool TelitWiFi::wait_connection(char *cid, uint32_t timeout)
 	if (ATCMD_RESP_TCP_SERVER_CONNECT != resp) {
 		result = false;
 	} else {
+		apply_socket_profile( *cid, mSockProfile );
 		result = true;
 	}
 	return result;
@@ -334,6 +1070,8 @@ char TelitWiFi::connectUDP(const String& ip, const String& port, const String& s
 		resp = AtCmd_NSTAT(&networkStatus);
 	} while (ATCMD_RESP_OK != resp);
 
+	apply_socket_profile( cid, mSockProfile, false );
+
 	ConsoleLog( "Connected" );
 	ConsolePrintf("IP: %d.%d.%d.%d\r\n",
 	              networkStatus.addr.ipv4[0], networkStatus.addr.ipv4[1], networkStatus.addr.ipv4[2], networkStatus.addr.ipv4[3]);
@@ -342,43 +1080,141 @@ char TelitWiFi::connectUDP(const String& ip, const String& port, const String& s
 }
 
 /**
- * @brief stop server
- * @param char cid: Channel ID
- * 
+ * @brief Start UDP server
+ * @param char* port - IN: Port
+ * @return char cid: Channel ID
  */
-void TelitWiFi::stop(char cid)
+char TelitWiFi::start_udp_server(char* port)
 {
-	ATCMD_RESP_E resp;
+	ATCMD_RESP_E resp = ATCMD_RESP_UNMATCH;
+	char cid = ATCMD_INVALID_CID;
 
-	while( !Get_GPIO37Status() );
+	WiFi_InitESCBuffer();
 
-	while( Get_GPIO37Status() ){
-		resp = AtCmd_RecvResponse();
+	resp = AtCmd_NSUDP(port, &cid);
+	if (resp != ATCMD_RESP_OK || cid == ATCMD_INVALID_CID) {
+		ConsoleLog( "No UDP Server!" );
+		return ATCMD_INVALID_CID;
+	}
 
-		if( ATCMD_RESP_BULK_DATA_RX == resp ){
+	apply_socket_profile( cid, mSockProfile, false );
 
-			WiFi_InitESCBuffer();
+	ConsoleLog( "UDP server Started" );
+	return cid;
+}
 
-		}else if( ATCMD_RESP_DISCONNECT == resp ){
-			resp = AtCmd_NCLOSE( cid );
-			resp = AtCmd_NCLOSEALL();
-			WiFi_InitESCBuffer();
+/**
+ * @brief Receive a datagram on UDP server
+ * @param char cid: Channel ID of UDP server
+ *        uint8_t *data - OUT: payload
+ *        int length - IN: size of data
+ *        ATCMD_IPv4 ip - OUT: source IP address
+ *        uint16_t *port - OUT: source port
+ *        uint32_t timeout - IN: milliseconds
+ * @return size of payload, -1: timeout
+ */
+int TelitWiFi::recvfrom(char cid, uint8_t* data, int length, ATCMD_IPv4 ip, uint16_t* port, uint32_t timeout)
+{
+	uint32_t start = millis();
+	int size;
+
+	while( msDelta( start ) < timeout ){
+		/* Datagrams of other CIDs stay parked for their readers */
+		pump();
+		size = park_take( cid, true, data, length, ip, port );
+		if( size >= 0 ){
+			first_packet();
+			return size;
 		}
 
-		sleep(2);
-
+		/* Nothing pending in GS2200, let other tasks run till it has */
+		if( !Get_GPIO37Status() )
+			delay( 1 );
 	}
 
+	return -1;
 }
 
 /**
- * @brief Is connected TCP server
- * @param char cid: Channel ID
- * 
+ * @brief Send a datagram from UDP server
+ * @param char cid: Channel ID of UDP server
+ *        const uint8_t *data - IN: payload
+ *        uint16_t length - IN: size of payload
+ *        const ATCMD_IPv4 ip - IN: destination IP address
+ *        uint16_t port - IN: destination port
  */
-bool TelitWiFi::connected(char cid)
+bool TelitWiFi::sendto(char cid, const uint8_t* data, uint16_t length, const ATCMD_IPv4 ip, uint16_t port)
 {
-	if( ( cid < '0' ) && ( cid > 'f' ) ){
+	ATCMD_RESP_E resp;
+
+	resp = AtCmd_UDP_SendBulkDataTo(cid, data, length, ip, port);
+	if( ATCMD_RESP_OK != resp ){
+		gs2200_printf( "Send Error.resp = %d\n", resp);
+		return false;
+	}
+
+	first_packet();
+	return true;
+}
+
+/**
+ * @brief stop server
+ * @param char cid: Channel ID
+ * 
+ */
+void TelitWiFi::stop(char cid)
+{
+	ATCMD_RESP_E resp;
+
+	set_coalesce( cid, false );
+	if( AtCmd_CidIndex( cid ) >= 0 )
+		mFlow[AtCmd_CidIndex( cid )].stalled = false;
+
+	while( !Get_GPIO37Status() );
+
+	while( Get_GPIO37Status() ){
+		resp = AtCmd_RecvResponse();
+
+		if( ATCMD_RESP_BULK_DATA_RX == resp ){
+
+			WiFi_InitESCBuffer();
+
+		}else if( ATCMD_RESP_DISCONNECT == resp ){
+			resp = AtCmd_NCLOSE( cid );
+			resp = AtCmd_NCLOSEALL();
+			WiFi_InitESCBuffer();
+		}
+
+		sleep(2);
+
+	}
+
+}
+
+/**
+ * @brief Close the connection without waiting for the server
+ * @param char cid: Channel ID
+ * 
+ */
+void TelitWiFi::close(char cid)
+{
+	set_coalesce( cid, false );
+	if( AtCmd_CidIndex( cid ) >= 0 )
+		mFlow[AtCmd_CidIndex( cid )].stalled = false;
+
+	AtCmd_NCLOSE( cid );
+	/* Anything the server answered is of no use any more */
+	WiFi_InitESCBuffer();
+}
+
+/**
+ * @brief Is connected TCP server
+ * @param char cid: Channel ID
+ * 
+ */
+bool TelitWiFi::connected(char cid)
+{
+	if( ( cid < '0' ) && ( cid > 'f' ) ){
 		return false;
 	}
 	return true;
@@ -393,45 +1229,1463 @@ bool TelitWiFi::connected(char cid)
  */
 bool TelitWiFi::write(char cid, const uint8_t* data, uint16_t length)
 {
-	ATCMD_RESP_E resp;
+	TWIFI_TxBuffer* buf;
+
+	if( mCoalesceCids & cid_bit( cid ) ){
+		/* All or nothing: room is made before a byte is taken, false never leaves part of the data buffered */
+		if( length > ATCMD_BULK_MAX_SIZE )
+			return false;
+		buf = find_tx_buffer( cid );
+		if( buf && length > ATCMD_BULK_MAX_SIZE - buf->length &&
+		    !coalesce_flush( buf, &mCoalesceStats.threshold, TWIFI_STREAM_TIMEOUT ) )
+			return false;
+		return coalesce( cid, data, length ) == length;
+	}
 
-	resp = AtCmd_SendBulkData(cid, data, length);
-	if( ATCMD_RESP_OK != resp){
-		// Data is not sent, we need to re-send the data
-		gs2200_printf( "Send Error.resp = %d\n", resp);
+	if( !send_bulk( cid, data, length ) ){
+		// Data is not sent, writable() tells when to re-send the data
+		gs2200_printf( "Send Error.credit = %d\n", WiFi_WriteCredit() );
 		return false;
 	}
 
+	first_packet();
 	return true;
 
 }
 
-bool TelitWiFi::available()
+/**
+ * @brief Send data of one <ESC>Z frame, retry until accepted or timeout
+ *        While the CID is stalled, the frames are sized by the room reported
+ * @param char cid: Channel ID
+ *        const uint8_t *data - IN: data pointer
+ *        uint16_t length - IN: data size (ATCMD_BULK_MAX_SIZE at most)
+ *        uint32_t timeout - IN: give up when no frame is accepted for this period
+ * @return the number of bytes delivered, less than length on timeout
+ */
+uint16_t TelitWiFi::send_frame(char cid, const uint8_t* data, uint16_t length, uint32_t timeout)
 {
-	return Get_GPIO37Status();
+	uint32_t start = millis();
+	uint16_t sent = 0;
+	uint16_t size;
+
+	while( sent < length ){
+		size = flow_size( cid, length - sent );
+		if( send_bulk( cid, data + sent, size ) ){
+			mTxStats.bytes += size;
+			mTxStats.frames++;
+			sent += size;
+			start = millis();
+			continue;
+		}
+
+		if( !wait_writable( cid, start, timeout ) ){
+			gs2200_printf( "Stream Error.credit = %d\n", WiFi_WriteCredit() );
+			break;
+		}
+		mTxStats.retries++;
+	}
+	return sent;
 }
 
-int TelitWiFi::read(char cid, uint8_t* data, int length)
+/**
+ * @brief Send one <ESC>Z frame once and keep the flow state of the CID
+ * @return true: GS2200 took it
+ */
+bool TelitWiFi::send_bulk(char cid, const uint8_t* data, uint16_t length)
 {
-	int size = -1;
-	ATCMD_RESP_E resp;
+	return flow_result( cid, ATCMD_RESP_OK == AtCmd_SendBulkData( cid, data, length ) );
+}
 
-	resp = AtCmd_RecvResponse();
+/**
+ * @brief Give frames built for the CID to GS2200 in one SPI write, waiting
+ *        for room on the flow of the CID up to the timeout
+ * @param char cid: Channel ID the refusals are counted for
+ *        const uint8_t *frames - IN: frames with their headers
+ *        uint16_t size - IN: size of all frames
+ *        uint32_t timeout - IN: milliseconds
+ * @return true: GS2200 took them
+ */
+bool TelitWiFi::write_frames(char cid, const uint8_t* frames, uint16_t size, uint32_t timeout)
+{
+	uint32_t start = millis();
 
-	if( ATCMD_RESP_BULK_DATA_RX == resp ){
-		if( Check_CID( cid ) ){
-			size = ESCBufferCnt-1;
-			if(size > length){
-				size = length;
-				ConsoleLog( "Lost some data.");
-			}
-			memcpy(data,(ESCBuffer + 1),size);
-		}else{
-			ConsoleLog( "Missmatch cid.");
+	while( !flow_result( cid, SPI_RESP_STATUS_OK == WiFi_Write( frames, size ) ) ){
+		if( !wait_writable( cid, start, timeout ) )
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Keep the flow state of the CID after a write to GS2200
+ * @param bool sent - IN: GS2200 took it
+ * @return sent
+ */
+bool TelitWiFi::flow_result(char cid, bool sent)
+{
+	TWIFI_Flow* flow;
+	uint32_t stall;
+
+	if( AtCmd_CidIndex( cid ) < 0 )
+		return sent;
+
+	flow = &mFlow[AtCmd_CidIndex( cid )];
+	flow->probe = millis();
+
+	if( sent ){
+		flow->stats.frames++;
+		if( flow->stalled ){
+			stall = msDelta( flow->since );
+			flow->stats.stallTime += stall;
+			if( flow->stats.maxStall < stall )
+				flow->stats.maxStall = stall;
+			flow->stalled = false;
+		}
+		return true;
+	}
+
+	flow->stats.refused++;
+	flow->stats.credit = WiFi_WriteCredit();
+	if( !flow->stalled ){
+		flow->stalled = true;
+		flow->since = flow->probe;
+		flow->stats.stalls++;
+	}
+	return false;
+}
+
+/**
+ * @brief Back off after GS2200 refused a frame to the CID
+ *        Nothing changes before the next probe, the wait is to that time in
+ *        one go. The credit of the refusal does not shorten it, GS2200 may
+ *        still refuse a frame that fits.
+ * @return false: timeout or invalid CID
+ */
+bool TelitWiFi::wait_writable(char cid, uint32_t start, uint32_t timeout)
+{
+	uint32_t elapsed = msDelta( start );
+	uint32_t since;
+	uint32_t wait;
+
+	if( AtCmd_CidIndex( cid ) < 0 || elapsed >= timeout )
+		return false;
+
+	since = msDelta( mFlow[AtCmd_CidIndex( cid )].probe );
+	wait = ( since < TWIFI_FLOW_PROBE ) ? TWIFI_FLOW_PROBE - since : 0;
+	if( wait > timeout - elapsed )
+		wait = timeout - elapsed;
+	if( wait )
+		delay( wait );
+	return msDelta( start ) < timeout;
+}
+
+/**
+ * @brief A write of length bytes to the CID is worth trying now
+ *        Room in the coalescing buffer, or GS2200 took the last frame, or
+ *        it had room for this one at the last refusal. Otherwise true again
+ *        after TWIFI_FLOW_PROBE ms, GS2200 tells its room only when asked.
+ * @param char cid: Channel ID
+ *        uint16_t length - IN: data size
+ */
+bool TelitWiFi::writable(char cid, uint16_t length)
+{
+	TWIFI_TxBuffer* buf;
+
+	if( mCoalesceCids & cid_bit( cid ) ){
+		buf = find_tx_buffer( cid );
+		if( length <= ATCMD_BULK_MAX_SIZE - ( buf ? buf->length : 0 ) )
+			return true;
+	}
+	return flow_ready( cid, length );
+}
+
+/**
+ * @brief A frame of length bytes to the CID is worth giving to GS2200 now
+ */
+bool TelitWiFi::flow_ready(char cid, uint16_t length)
+{
+	TWIFI_Flow* flow;
+
+	if( AtCmd_CidIndex( cid ) < 0 )
+		return false;
+
+	flow = &mFlow[AtCmd_CidIndex( cid )];
+	if( !flow->stalled )
+		return true;
+	if( length + TWIFI_FLOW_HEADER <= flow->stats.credit )
+		return true;
+	return msDelta( flow->probe ) >= TWIFI_FLOW_PROBE;
+}
+
+/**
+ * @brief Bytes of length worth putting in the next frame to the CID
+ *        While it is stalled, what GS2200 had room for at the last refusal
+ */
+uint16_t TelitWiFi::flow_size(char cid, uint16_t length)
+{
+	TWIFI_Flow* flow;
+
+	if( AtCmd_CidIndex( cid ) < 0 )
+		return length;
+
+	flow = &mFlow[AtCmd_CidIndex( cid )];
+	if( flow->stalled && flow->stats.credit > TWIFI_FLOW_HEADER &&
+	    flow->stats.credit - TWIFI_FLOW_HEADER < length )
+		return flow->stats.credit - TWIFI_FLOW_HEADER;
+	return length;
+}
+
+/**
+ * @brief Send data of any size, waiting for room in GS2200 up to a deadline
+ * @param char cid: Channel ID
+ *        const uint8_t *data - IN: data pointer
+ *        size_t length - IN: data size
+ *        uint32_t deadline - IN: ms from now
+ * @return the number of bytes delivered
+ */
+size_t TelitWiFi::write_until(char cid, const uint8_t* data, size_t length, uint32_t deadline)
+{
+	uint32_t start = millis();
+	size_t sent = 0;
+	uint16_t size;
+
+	if( !flush( cid ) )
+		return 0;
+
+	while( sent < length ){
+		size = ( length - sent > ATCMD_BULK_MAX_SIZE ) ? ATCMD_BULK_MAX_SIZE : length - sent;
+		size = flow_size( cid, size );
+		if( send_bulk( cid, data + sent, size ) )
+			sent += size;
+		else if( !wait_writable( cid, start, deadline ) )
+			break;
+	}
+
+	if( sent )
+		first_packet();
+	return sent;
+}
+
+/**
+ * @brief Flow control statistics of the CID
+ * @param char cid: Channel ID
+ *        TWIFI_FlowStats *stats - OUT: statistics
+ */
+void TelitWiFi::get_flow_stats(char cid, TWIFI_FlowStats* stats)
+{
+	TWIFI_TxBuffer* buf;
+	TWIFI_Flow* flow;
+
+	memset( stats, 0, sizeof(*stats) );
+	if( AtCmd_CidIndex( cid ) < 0 )
+		return;
+
+	flow = &mFlow[AtCmd_CidIndex( cid )];
+	*stats = flow->stats;
+	stats->stalled = flow->stalled ? msDelta( flow->since ) : 0;
+	if( ( buf = find_tx_buffer( cid ) ) != NULL )
+		stats->backlog = buf->length;
+}
+
+void TelitWiFi::reset_flow_stats()
+{
+	for( int i = 0; i < ATCMD_MAX_CID; i++ )
+		memset( &mFlow[i].stats, 0, sizeof(mFlow[i].stats) );
+}
+
+/**
+ * @brief Finish the statistics of write_stream
+ */
+void TelitWiFi::stream_done(uint32_t start)
+{
+	mTxStats.elapsed = msDelta( start );
+	mTxStats.throughput = mTxStats.elapsed ? (uint32_t)((uint64_t)mTxStats.bytes * 1000 / mTxStats.elapsed) : 0;
+
+	if( mTxStats.bytes )
+		first_packet();
+
+	gs2200_printf( "Stream: %d bytes, %d frames, %d ms, %d bytes/s\n",
+	               mTxStats.bytes, mTxStats.frames, mTxStats.elapsed, mTxStats.throughput );
+}
+
+/**
+ * @brief Send data of any size to TCP server
+ *        Data is split into <ESC>Z frames, a frame failed is sent again
+ *        so that the bytes already delivered are never sent twice.
+ * @param char cid: Channel ID
+ *        const uint8_t *data - IN: data pointer
+ *        size_t length - IN: data size
+ *        uint32_t timeout - IN: give up when no frame is accepted for this period
+ * @return the number of bytes delivered
+ */
+size_t TelitWiFi::write_stream(char cid, const uint8_t* data, size_t length, uint32_t timeout)
+{
+	TWIFI_TxBuffer* buf;
+	uint32_t start = millis();
+	size_t sent = 0;
+	uint16_t size, n;
+
+	memset( &mTxStats, 0, sizeof(mTxStats) );
+
+	/* Small writes pending go out in one frame with the start of the stream */
+	if( ( buf = find_tx_buffer( cid ) ) != NULL ){
+		size = ( length < (size_t)( ATCMD_BULK_MAX_SIZE - buf->length ) ) ? length : ATCMD_BULK_MAX_SIZE - buf->length;
+		memcpy( buf->data + buf->length, data, size );
+		buf->length += size;
+		buf->writes++;
+		mCoalesceStats.writes++;
+		if( !coalesce_flush( buf, &mCoalesceStats.request, timeout ) ){
+			/* The small writes stay buffered, the stream is not started */
+			buf->length -= size;
+			buf->writes--;
+			mCoalesceStats.writes--;
+			stream_done( start );
+			return 0;
 		}
+		mTxStats.bytes += size;
+		mTxStats.frames++;
+		sent = size;
+	}
+
+	while( sent < length ){
+		size = ( length - sent > ATCMD_BULK_MAX_SIZE ) ? ATCMD_BULK_MAX_SIZE : length - sent;
+		n = send_frame( cid, data + sent, size, timeout );
+		sent += n;
+		if( n < size )
+			break;
+	}
+
+	stream_done( start );
+	return sent;
+}
+
+/**
+ * @brief Send data given by the producer to TCP server
+ * @param char cid: Channel ID
+ *        TWIFI_Producer producer - IN: fills the frame, returns 0 at the end
+ *        void *arg - IN: argument of the producer
+ *        uint32_t timeout - IN: give up when no frame is accepted for this period
+ * @return the number of bytes delivered
+ */
+size_t TelitWiFi::write_stream(char cid, TWIFI_Producer producer, void* arg, uint32_t timeout)
+{
+	static uint8_t frame[ATCMD_BULK_MAX_SIZE];
+	uint32_t start = millis();
+	size_t sent = 0;
+	int size, n;
+
+	memset( &mTxStats, 0, sizeof(mTxStats) );
+
+	if( !flush( cid ) ){
+		stream_done( start );
+		return 0;
+	}
+
+	while( 1 ){
+		size = producer( frame, sizeof(frame), arg );
+		if( size <= 0 )
+			break;
+		if( size > ATCMD_BULK_MAX_SIZE )
+			size = ATCMD_BULK_MAX_SIZE;
+		n = send_frame( cid, frame, size, timeout );
+		sent += n;
+		if( n < size )
+			break;
+	}
+
+	stream_done( start );
+	return sent;
+}
+
+/**
+ * @brief Statistics of the last write_stream
+ * @param TWIFI_TxStats *stats - OUT: statistics
+ */
+void TelitWiFi::get_tx_stats(TWIFI_TxStats* stats)
+{
+	*stats = mTxStats;
+}
+
+/**
+ * @brief Make room for a frame in the batch, flush it if necessary
+ * @param uint16_t size - IN: header and data size of the frame
+ * @return true: room available, false: frame too large or flush error
+ */
+bool TelitWiFi::batch_reserve(uint16_t size)
+{
+	if( !mBatch && ( mBatch = (uint8_t*)malloc( TWIFI_BATCH_SIZE ) ) == NULL ){
+		ConsoleLog( "No memory for the batch" );
+		mBatchStats.dropped++;
+		return false;
+	}
+
+	if( size > TWIFI_BATCH_SIZE ){
+		mBatchStats.dropped++;
+		return false;
+	}
+
+	if( mBatchLen + size > TWIFI_BATCH_SIZE ){
+		if( !batch_flush() )
+			return false;
+	}
+
+	if( !mBatchCount )
+		mBatchOldest = millis();
+	if( !mBatchStats.datagrams && !mBatchCount )
+		mBatchStart = millis();
+
+	return true;
+}
+
+/**
+ * @brief Queue a datagram of UDP client as <ESC>Z frame
+ * @param char cid: Channel ID
+ *        const uint8_t *data - IN: datagram
+ *        uint16_t length - IN: size of datagram
+ * @return true: queued (the batch may have been flushed), false: error
+ */
+bool TelitWiFi::batch_add(char cid, const uint8_t* data, uint16_t length)
+{
+	if( length > ATCMD_BULK_MAX_SIZE || !batch_reserve( 7 + length ) ){
+		return false;
+	}
+
+	if( !mBatchCount )
+		mBatchCid = cid;
+	mBatchLen += AtCmd_BulkHeader( mBatch + mBatchLen, cid, length );
+	memcpy( mBatch + mBatchLen, data, length );
+	mBatchLen += length;
+	mBatchCount++;
+
+	batch_poll();
+	return true;
+}
+
+/**
+ * @brief Queue a datagram of UDP server as <ESC>Y frame
+ * @param char cid: Channel ID of UDP server
+ *        const uint8_t *data - IN: datagram
+ *        uint16_t length - IN: size of datagram
+ *        const ATCMD_IPv4 ip - IN: destination IP address
+ *        uint16_t port - IN: destination port
+ * @return true: queued (the batch may have been flushed), false: error
+ */
+bool TelitWiFi::batch_add_to(char cid, const uint8_t* data, uint16_t length, const ATCMD_IPv4 ip, uint16_t port)
+{
+	uint8_t header[ATCMD_UDP_HEADER_MAX_SIZE];
+	uint16_t headerLen;
+
+	headerLen = AtCmd_UDP_BulkHeader( header, cid, length, ip, port );
+	if( !batch_reserve( headerLen + length ) ){
+		return false;
+	}
+
+	if( !mBatchCount )
+		mBatchCid = cid;
+	memcpy( mBatch + mBatchLen, header, headerLen );
+	mBatchLen += headerLen;
+	memcpy( mBatch + mBatchLen, data, length );
+	mBatchLen += length;
+	mBatchCount++;
+
+	batch_poll();
+	return true;
+}
+
+/**
+ * @brief Send all queued datagrams in one SPI write
+ *        A refusal stalls the flow of the first CID in the batch
+ * @return true: sent or nothing to send, false: datagrams dropped
+ */
+bool TelitWiFi::batch_flush()
+{
+	bool sent;
+
+	if( !mBatchCount )
+		return true;
+
+	sent = write_frames( mBatchCid, mBatch, mBatchLen, TWIFI_STREAM_TIMEOUT );
+	if( sent ){
+		mBatchStats.datagrams += mBatchCount;
+		mBatchStats.writes++;
+		first_packet();
 	}else{
-		gs2200_printf( "Recieve another event.");
+		gs2200_printf( "Batch Error, %d datagrams dropped\n", mBatchCount );
+		mBatchStats.dropped += mBatchCount;
 	}
 
-	return size;
+	mBatchStats.elapsed = msDelta( mBatchStart );
+	mBatchStats.rate = mBatchStats.elapsed ? (uint32_t)((uint64_t)mBatchStats.datagrams * 1000 / mBatchStats.elapsed) : 0;
+
+	mBatchLen = 0;
+	mBatchCount = 0;
+
+	return sent;
+}
+
+/**
+ * @brief Flush the batch if the oldest datagram has waited for the deadline
+ *        Call this periodically when datagrams are queued slowly
+ * @return true: no error
+ */
+bool TelitWiFi::batch_poll()
+{
+	if( mBatchCount && mBatchDeadline && msDelta( mBatchOldest ) >= mBatchDeadline )
+		return batch_flush();
+
+	return true;
+}
+
+/**
+ * @brief Set the flush deadline of queued datagrams
+ * @param uint32_t ms - IN: milliseconds, 0: flush only when full or by batch_flush()
+ */
+void TelitWiFi::set_batch_deadline(uint32_t ms)
+{
+	mBatchDeadline = ms;
+}
+
+/**
+ * @brief Statistics of batched UDP transmit
+ * @param TWIFI_BatchStats *stats - OUT: statistics
+ */
+void TelitWiFi::get_batch_stats(TWIFI_BatchStats* stats)
+{
+	*stats = mBatchStats;
+}
+
+/**
+ * @brief Restart the measurement of batched UDP transmit
+ */
+void TelitWiFi::reset_batch_stats()
+{
+	memset( &mBatchStats, 0, sizeof(mBatchStats) );
+}
+
+/**
+ * @brief Collect small writes of a TCP CID into one <ESC>Z frame
+ *        Not for UDP, the datagrams would be merged.
+ * @param char cid: Channel ID
+ *        bool enable - IN: false sends what is pending and stops it
+ */
+void TelitWiFi::set_coalesce(char cid, bool enable)
+{
+	if( enable ){
+		mCoalesceCids |= cid_bit( cid );
+	}else{
+		if( !flush( cid ) )
+			coalesce_drop( cid );
+		mCoalesceCids &= ~cid_bit( cid );
+	}
+}
+
+/**
+ * @brief When the collected data is sent
+ * @param uint16_t threshold - IN: bytes, ATCMD_BULK_MAX_SIZE at most
+ *        uint32_t delay - IN: milliseconds after the first write
+ */
+void TelitWiFi::set_coalesce_timing(uint16_t threshold, uint32_t delay)
+{
+	mCoalesceThreshold = ( threshold && threshold < ATCMD_BULK_MAX_SIZE ) ? threshold : ATCMD_BULK_MAX_SIZE;
+	mCoalesceDelay = delay;
+}
+
+/**
+ * @brief Send what is collected for the CID
+ * @return true: sent or nothing to send, false: not taken in time, still buffered
+ */
+bool TelitWiFi::flush(char cid)
+{
+	TWIFI_TxBuffer* buf = find_tx_buffer( cid );
+
+	return !buf || coalesce_flush( buf, &mCoalesceStats.request, TWIFI_STREAM_TIMEOUT );
+}
+
+/**
+ * @brief Send what is collected for every CID
+ */
+bool TelitWiFi::flush()
+{
+	bool result = true;
+
+	for( int i = 0; i < TWIFI_COALESCE_NUM; i++ ){
+		if( mTxBuffers[i].cid != ATCMD_INVALID_CID &&
+		    !coalesce_flush( &mTxBuffers[i], &mCoalesceStats.request, TWIFI_STREAM_TIMEOUT ) )
+			result = false;
+	}
+	return result;
+}
+
+/**
+ * @brief Send the buffers whose first write waited for the delay
+ *        One try without waiting, a buffer GS2200 has no room for stays
+ */
+void TelitWiFi::coalesce_poll()
+{
+	for( int i = 0; i < TWIFI_COALESCE_NUM; i++ ){
+		if( mTxBuffers[i].cid != ATCMD_INVALID_CID && msDelta( mTxBuffers[i].oldest ) >= mCoalesceDelay )
+			coalesce_flush( &mTxBuffers[i], &mCoalesceStats.timer, 0 );
+	}
+}
+
+void TelitWiFi::get_coalesce_stats(TWIFI_CoalesceStats* stats)
+{
+	*stats = mCoalesceStats;
+}
+
+void TelitWiFi::reset_coalesce_stats()
+{
+	memset( &mCoalesceStats, 0, sizeof(mCoalesceStats) );
+}
+
+/**
+ * @brief Take data into the buffer of the CID, full frames are sent
+ * @return the number of bytes taken
+ */
+size_t TelitWiFi::coalesce(char cid, const uint8_t* data, size_t length)
+{
+	TWIFI_TxBuffer* buf;
+	size_t done = 0;
+	uint16_t n;
+
+	coalesce_poll();
+	mCoalesceStats.writes++;
+
+	while( done < length ){
+		if( ( buf = coalesce_buffer( cid ) ) == NULL )
+			break;
+
+		n = ATCMD_BULK_MAX_SIZE - buf->length;
+		if( n > length - done )
+			n = length - done;
+		if( !n )
+			/* Full and GS2200 did not take it in time */
+			break;
+		memcpy( buf->data + buf->length, data + done, n );
+		buf->length += n;
+		buf->writes++;
+		done += n;
+
+		if( buf->length >= mCoalesceThreshold )
+			coalesce_flush( buf, &mCoalesceStats.threshold, TWIFI_STREAM_TIMEOUT );
+	}
+
+	return done;
+}
+
+TWIFI_TxBuffer* TelitWiFi::find_tx_buffer(char cid)
+{
+	if( cid == ATCMD_INVALID_CID )
+		return NULL;
+
+	for( int i = 0; i < TWIFI_COALESCE_NUM; i++ ){
+		if( mTxBuffers[i].cid == cid )
+			return &mTxBuffers[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief Buffer of the CID, a free one or the oldest one after sending it
+ */
+TWIFI_TxBuffer* TelitWiFi::coalesce_buffer(char cid)
+{
+	TWIFI_TxBuffer* buf = find_tx_buffer( cid );
+	TWIFI_TxBuffer* oldest = NULL;
+
+	if( buf || cid == ATCMD_INVALID_CID )
+		return buf;
+
+	for( int i = 0; i < TWIFI_COALESCE_NUM; i++ ){
+		if( mTxBuffers[i].cid == ATCMD_INVALID_CID ){
+			buf = &mTxBuffers[i];
+			if( !buf->data && ( buf->data = (uint8_t*)malloc( ATCMD_BULK_MAX_SIZE ) ) == NULL )
+				return NULL;
+			break;
+		}
+		if( !oldest || (int32_t)( mTxBuffers[i].oldest - oldest->oldest ) < 0 )
+			oldest = &mTxBuffers[i];
+	}
+
+	if( !buf ){
+		if( !coalesce_flush( oldest, &mCoalesceStats.evicted, TWIFI_STREAM_TIMEOUT ) )
+			return NULL;
+		buf = oldest;
+	}
+
+	buf->cid = cid;
+	buf->length = 0;
+	buf->writes = 0;
+	buf->oldest = millis();
+	return buf;
+}
+
+/**
+ * @brief Send the buffer as one frame and free it
+ * @param TWIFI_TxBuffer *buf - IN: buffer in use
+ *        uint32_t *reason - IN: counter of the cause
+ *        uint32_t timeout - IN: milliseconds to wait for room, 0 to try once
+ * @return true: sent, false: not accepted in time, the buffer is kept
+ */
+bool TelitWiFi::coalesce_flush(TWIFI_TxBuffer* buf, uint32_t* reason, uint32_t timeout)
+{
+	uint32_t start = millis();
+
+	while( buf->length && !( flow_ready( buf->cid, buf->length ) && send_bulk( buf->cid, buf->data, buf->length ) ) ){
+		if( !wait_writable( buf->cid, start, timeout ) )
+			return false;
+	}
+
+	if( buf->length ){
+		(*reason)++;
+		mCoalesceStats.frames++;
+		mCoalesceStats.saved += buf->writes - 1;
+		first_packet();
+	}
+
+	buf->cid = ATCMD_INVALID_CID;
+	return true;
+}
+
+/**
+ * @brief Give up what is buffered for the CID
+ */
+void TelitWiFi::coalesce_drop(char cid)
+{
+	TWIFI_TxBuffer* buf = find_tx_buffer( cid );
+
+	if( !buf )
+		return;
+
+	if( buf->length ){
+		gs2200_printf( "Coalesce: %d bytes of CID %c lost\n", buf->length, buf->cid );
+		mCoalesceStats.dropped++;
+	}
+	buf->cid = ATCMD_INVALID_CID;
+}
+
+bool TelitWiFi::available()
+{
+	coalesce_poll();
+	return mParkCount || Get_GPIO37Status();
+}
+
+/**
+ * @brief Read the oldest frame of a CID without a socket
+ *        Frames of other CIDs stay parked. <ESC>H data of HttpGs2200 is
+ *        not parked, it is taken from ESCBuffer.
+ * @return size of data, -1 if there is none
+ */
+int TelitWiFi::read(char cid, uint8_t* data, int length)
+{
+	int size;
+
+	pump();
+	size = park_take( cid, false, data, length, NULL, NULL );
+
+	if( size < 0 && ESCBufferCnt > 1 && Check_CID( cid ) ){
+		size = ESCBufferCnt-1;
+		if(size > length){
+			size = length;
+			ConsoleLog( "Lost some data.");
+		}
+		memcpy(data,(ESCBuffer + 1),size);
+		WiFi_InitESCBuffer();
+	}
+
+	if( size > 0 )
+		first_packet();
+	return size;
+}
+
+/**
+ * @brief Copy into the ring of a socket at offset pos from the oldest byte
+ */
+static void ring_put(TWIFI_Socket* sock, uint16_t pos, const void* data, uint16_t length)
+{
+	uint16_t at = ( sock->rxHead + pos ) % TWIFI_SOCKET_RX_SIZE;
+	uint16_t first = ( length < TWIFI_SOCKET_RX_SIZE - at ) ? length : TWIFI_SOCKET_RX_SIZE - at;
+
+	memcpy( sock->rx + at, data, first );
+	memcpy( sock->rx, (const uint8_t*)data + first, length - first );
+}
+
+/**
+ * @brief Copy from the ring at offset pos from the oldest byte
+ */
+static void ring_peek(TWIFI_Socket* sock, uint16_t pos, void* data, uint16_t length)
+{
+	uint16_t at = ( sock->rxHead + pos ) % TWIFI_SOCKET_RX_SIZE;
+	uint16_t first = ( length < TWIFI_SOCKET_RX_SIZE - at ) ? length : TWIFI_SOCKET_RX_SIZE - at;
+
+	memcpy( data, sock->rx + at, first );
+	memcpy( (uint8_t*)data + first, sock->rx, length - first );
+}
+
+/**
+ * @brief Copy length bytes from the oldest byte of the ring and drop them
+ */
+static void ring_get(TWIFI_Socket* sock, void* data, uint16_t length)
+{
+	if( data )
+		ring_peek( sock, 0, data, length );
+	sock->rxHead = ( sock->rxHead + length ) % TWIFI_SOCKET_RX_SIZE;
+	sock->rxLen -= length;
+}
+
+TWIFI_Socket* TelitWiFi::find_socket(char cid)
+{
+	if( cid == ATCMD_INVALID_CID )
+		return NULL;
+
+	for( int i = 0; i < TWIFI_SOCKET_NUM; i++ ){
+		if( mSockets[i].cid == cid )
+			return &mSockets[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief Receive the data of a CID into its own ring from now on
+ * @param char cid: Channel ID
+ *        bool udp - IN: keep datagrams with their source
+ *        char server - IN: listening CID the connection was accepted on
+ * @return false: no free socket
+ */
+bool TelitWiFi::socket_attach(char cid, bool udp, char server)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+
+	for( int i = 0; !sock && i < TWIFI_SOCKET_NUM; i++ ){
+		if( mSockets[i].cid == ATCMD_INVALID_CID )
+			sock = &mSockets[i];
+	}
+	if( !sock ){
+		ConsoleLog( "No free socket" );
+		return false;
+	}
+	if( !sock->rx && ( sock->rx = (uint8_t*)malloc( TWIFI_SOCKET_RX_SIZE ) ) == NULL ){
+		ConsoleLog( "No memory for the socket" );
+		return false;
+	}
+
+	sock->cid = cid;
+	sock->server = server;
+	sock->udp = udp;
+	sock->closed = false;
+	sock->rxHead = sock->rxLen = 0;
+	sock->rxOpen = false;
+	sock->rxDiscard = false;
+	sock->dropped = 0;
+
+	AtCmd_SetBulkHandler( on_bulk, cid, this );
+	if( udp )
+		AtCmd_SetUDPHandler( on_udp, this );
+
+	return true;
+}
+
+/**
+ * @brief Send what is buffered, close the CID and free its socket
+ */
+void TelitWiFi::socket_close(char cid)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+
+	if( !sock )
+		return;
+
+	if( !sock->closed ){
+		socket_flush( cid );
+		AtCmd_NCLOSE( cid );
+	}
+	/* Not taken in time, or nobody to send it to */
+	coalesce_drop( cid );
+	accept_remove( cid );
+	AtCmd_SetBulkHandler( NULL, cid, NULL );
+	sock->cid = ATCMD_INVALID_CID;
+}
+
+/**
+ * @brief Bytes buffered (TCP) or size of the next datagram (UDP)
+ */
+int TelitWiFi::socket_available(char cid)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+	TWIFI_Datagram dg;
+
+	if( !sock )
+		return 0;
+
+	if( !sock->udp )
+		return sock->rxLen;
+
+	/* Only complete datagrams count */
+	if( ( sock->rxOpen ? sock->rxFrame : sock->rxLen ) < sizeof(dg) )
+		return 0;
+
+	ring_peek( sock, 0, &dg, sizeof(dg) );
+	return dg.length;
+}
+
+int TelitWiFi::socket_read(char cid, uint8_t* data, int length)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+
+	if( !sock || sock->udp || !sock->rxLen )
+		return -1;
+
+	if( length > sock->rxLen )
+		length = sock->rxLen;
+	ring_get( sock, data, length );
+	return length;
+}
+
+int TelitWiFi::socket_peek(char cid)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+
+	if( !sock || sock->udp || !sock->rxLen )
+		return -1;
+
+	return sock->rx[sock->rxHead];
+}
+
+/**
+ * @brief Take the next datagram of a UDP socket
+ * @return size of the datagram, -1 if none. A longer datagram is truncated
+ */
+int TelitWiFi::socket_recvfrom(char cid, uint8_t* data, int length, ATCMD_IPv4 ip, uint16_t* port)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+	TWIFI_Datagram dg;
+	int size;
+
+	if( !sock || !sock->udp || ( sock->rxOpen ? sock->rxFrame : sock->rxLen ) < sizeof(dg) )
+		return -1;
+
+	ring_get( sock, &dg, sizeof(dg) );
+	size = ( dg.length < length ) ? dg.length : length;
+	ring_get( sock, data, size );
+	ring_get( sock, NULL, dg.length - size );
+	if( sock->rxOpen )
+		sock->rxFrame -= sizeof(dg) + dg.length;
+
+	if( ip )
+		memcpy( ip, dg.ip, sizeof(ATCMD_IPv4) );
+	if( port )
+		*port = dg.port;
+	return size;
+}
+
+/**
+ * @brief Buffer data for the CID, a full frame is sent at once
+ * @return the number of bytes taken
+ */
+size_t TelitWiFi::socket_write(char cid, const uint8_t* data, size_t length)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+
+	if( !sock || sock->closed )
+		return 0;
+
+	return coalesce( cid, data, length );
+}
+
+/**
+ * @brief Send the buffered data of the CID as one frame
+ */
+bool TelitWiFi::socket_flush(char cid)
+{
+	return flush( cid );
+}
+
+/**
+ * @brief The peer closed the connection, or the CID is not attached
+ */
+bool TelitWiFi::socket_closed(char cid)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+
+	return !sock || sock->closed;
+}
+
+/**
+ * @brief Bytes lost because the ring of the CID was full, since it was attached
+ */
+uint32_t TelitWiFi::socket_dropped(char cid)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+
+	return sock ? sock->dropped : 0;
+}
+
+/**
+ * @brief A connection accepted on the server CID, pump() attaches them
+ * @param char server: listening CID
+ *        char after - IN: continue the search after this CID
+ * @return CID, ATCMD_INVALID_CID if none
+ */
+char TelitWiFi::socket_accepted(char server, char after)
+{
+	int i = 0;
+
+	if( server == ATCMD_INVALID_CID )
+		return ATCMD_INVALID_CID;
+
+	if( after != ATCMD_INVALID_CID ){
+		for( ; i < TWIFI_SOCKET_NUM && mSockets[i].cid != after; i++ );
+		i++;
+	}
+
+	for( ; i < TWIFI_SOCKET_NUM; i++ ){
+		if( mSockets[i].cid != ATCMD_INVALID_CID && mSockets[i].server == server )
+			return mSockets[i].cid;
+	}
+	return ATCMD_INVALID_CID;
+}
+
+/**
+ * @brief Take the oldest connection accepted on the server CID
+ * @param char server: listening CID
+ *        char cid - IN: take this one, ATCMD_INVALID_CID for the oldest
+ * @return CID, ATCMD_INVALID_CID if none is pending
+ */
+char TelitWiFi::socket_accept(char server, char cid)
+{
+	for( int i = 0; i < mAcceptStats.pending; i++ ){
+		if( mAcceptServer[i] == server && ( cid == ATCMD_INVALID_CID || mAcceptCid[i] == cid ) ){
+			cid = mAcceptCid[i];
+			accept_remove( cid );
+			return cid;
+		}
+	}
+	return ATCMD_INVALID_CID;
+}
+
+void TelitWiFi::get_accept_stats(TWIFI_AcceptStats* stats)
+{
+	*stats = mAcceptStats;
+}
+
+/**
+ * @brief Attach a connection accepted on an attached server and queue it
+ *        GS2200 keeps accepting, so one that cannot be buffered is closed
+ */
+void TelitWiFi::accept_add(char cid, char server)
+{
+	if( mAcceptStats.pending == TWIFI_ACCEPT_NUM || !socket_attach( cid, false, server ) ){
+		AtCmd_NCLOSE( cid );
+		mAcceptStats.refused++;
+		return;
+	}
+
+	apply_socket_profile( cid, mSockProfile );
+
+	mAcceptCid[mAcceptStats.pending] = cid;
+	mAcceptServer[mAcceptStats.pending] = server;
+	mAcceptStats.pending++;
+	mAcceptStats.accepted++;
+	if( mAcceptStats.peak < mAcceptStats.pending )
+		mAcceptStats.peak = mAcceptStats.pending;
+}
+
+void TelitWiFi::accept_clear()
+{
+	mAcceptStats.pending = 0;
+}
+
+void TelitWiFi::accept_remove(char cid)
+{
+	for( int i = 0; i < mAcceptStats.pending; i++ ){
+		if( mAcceptCid[i] == cid ){
+			mAcceptStats.pending--;
+			memmove( &mAcceptCid[i], &mAcceptCid[i + 1], mAcceptStats.pending - i );
+			memmove( &mAcceptServer[i], &mAcceptServer[i + 1], mAcceptStats.pending - i );
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Room for one more read of GS2200 in every open TCP socket and in
+ *        the park. A read of small frames takes more in the park than on
+ *        the wire, a header for every 8 bytes at most, twice is enough.
+ */
+bool TelitWiFi::rx_room()
+{
+	if( mPark && TWIFI_PARK_SIZE - mParkLen < 2 * MAX_RECEIVED_DATA )
+		return false;
+
+	for( int i = 0; i < TWIFI_SOCKET_NUM; i++ ){
+		if( mSockets[i].cid != ATCMD_INVALID_CID && !mSockets[i].udp && !mSockets[i].closed &&
+		    TWIFI_SOCKET_RX_SIZE - mSockets[i].rxLen < MAX_RECEIVED_DATA )
+			return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Read everything GS2200 has, without waiting
+ *        Data goes to the attached sockets, DISCONNECT marks them closed and
+ *        connections to an attached server are attached and queued as they come.
+ *        Reading stops while a TCP socket could not take a whole read, the
+ *        data stays in GS2200 until the application makes room. Frames of
+ *        CIDs without a socket are parked for read()/recvfrom(), they do
+ *        not hold up the sockets.
+ */
+void TelitWiFi::pump()
+{
+	ATCMD_RESP_E resp;
+	TWIFI_Socket* sock;
+	uint32_t count;
+	char cid, server;
+
+	if( !mPark )
+		mPark = (uint8_t*)malloc( TWIFI_PARK_SIZE );
+
+	AtCmd_SetBulkHandler( on_bulk, ATCMD_INVALID_CID, this );
+	AtCmd_SetUDPHandler( on_udp, this );
+
+	while( Get_GPIO37Status() && rx_room() ){
+		count = ESCBufferCnt;
+		resp = AtCmd_RecvResponse();
+
+		if( ESCBufferCnt != count ){
+			/* <ESC>H data without a handler, leave it to its reader */
+			break;
+		}
+
+		if( ATCMD_RESP_DISCONNECT == resp ){
+			cid = AtCmd_DisconnectCID();
+			if( ( sock = find_socket( cid ) ) != NULL )
+				sock->closed = true;
+			for( int i = 0; i < TWIFI_REOPEN_NUM; i++ ){
+				/* Maybe the link, see at the next supervise() */
+				if( mReopen[i].cid == cid )
+					mLinkCheckDue = true;
+			}
+			notify( resp, cid );
+		}
+		else if( ATCMD_RESP_DISASSOCIATION_EVENT == resp ){
+			if( TWIFI_LINK_UP == mLinkState )
+				link_lost();
+			notify( resp, ATCMD_INVALID_CID );
+		}
+		else if( ATCMD_RESP_TCP_SERVER_CONNECT == resp ){
+			cid = AtCmd_ConnectCID( &server );
+			if( cid != ATCMD_INVALID_CID && find_socket( server ) )
+				accept_add( cid, server );
+		}
+	}
+
+	/* Outside pump() they go to ESCBuffer as before */
+	AtCmd_SetBulkHandler( NULL, ATCMD_INVALID_CID, NULL );
+	coalesce_poll();
+}
+
+/**
+ * @brief Tell a handler of the DISCONNECT and DISASSOCIATION events read by pump()
+ * @param TWIFI_EventHandler handler - IN: called with arg from pump()
+ * @return false if every place is taken
+ */
+bool TelitWiFi::add_event_handler(TWIFI_EventHandler handler, void *arg)
+{
+	int free = -1;
+
+	for( int i = 0; i < TWIFI_LISTENER_NUM; i++ ){
+		if( mListeners[i].handler == handler && mListeners[i].arg == arg )
+			return true;
+		if( !mListeners[i].handler && free < 0 )
+			free = i;
+	}
+	if( free < 0 )
+		return false;
+
+	mListeners[free].handler = handler;
+	mListeners[free].arg = arg;
+	return true;
+}
+
+void TelitWiFi::remove_event_handler(TWIFI_EventHandler handler, void *arg)
+{
+	for( int i = 0; i < TWIFI_LISTENER_NUM; i++ ){
+		if( mListeners[i].handler == handler && mListeners[i].arg == arg )
+			mListeners[i].handler = NULL;
+	}
+}
+
+void TelitWiFi::notify(ATCMD_RESP_E event, char cid)
+{
+	for( int i = 0; i < TWIFI_LISTENER_NUM; i++ ){
+		if( mListeners[i].handler )
+			mListeners[i].handler( event, cid, mListeners[i].arg );
+	}
+}
+
+/**
+ * @brief Wait until one of the CIDs is ready
+ *        Readiness is taken from the sockets and from the frames parked by
+ *        pump(), nothing is read for the application. CIDs handled by
+ *        MqttGs2200 or HttpGs2200 are never readable here, and only the
+ *        open sockets are writable.
+ * @param TWIFI_PollFd *fds - IN/OUT: CIDs and events, revents is set
+ *        uint8_t count - IN: number of fds
+ *        uint32_t timeout - IN: milliseconds, 0 to check once
+ * @return the number of fds with revents set, 0 on timeout
+ */
+int TelitWiFi::poll(TWIFI_PollFd* fds, uint8_t count, uint32_t timeout)
+{
+	uint32_t start = millis();
+	int ready;
+
+	while( 1 ){
+		supervise();
+
+		ready = 0;
+		for( uint8_t i = 0; i < count; i++ ){
+			fds[i].revents = poll_events( fds[i].cid ) & ( fds[i].events | TWIFI_POLLHUP );
+			if( fds[i].revents )
+				ready++;
+		}
+
+		if( ready || msDelta( start ) >= timeout )
+			return ready;
+
+		if( !Get_GPIO37Status() )
+			delay( 1 );
+	}
+}
+
+uint8_t TelitWiFi::poll_events(char cid)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+	uint8_t events = 0;
+
+	if( cid == ATCMD_INVALID_CID )
+		return 0;
+
+	if( !sock ){
+		/* Not buffered, only the frames parked by pump() are known */
+		return parked( cid ) ? TWIFI_POLLIN : 0;
+	}
+
+	if( socket_available( cid ) )
+		events |= TWIFI_POLLIN;
+	for( int i = 0; i < mAcceptStats.pending; i++ ){
+		if( mAcceptServer[i] == cid )
+			events |= TWIFI_POLLIN;
+	}
+
+	if( sock->closed )
+		events |= TWIFI_POLLHUP;
+	else if( writable( cid ) )
+		events |= TWIFI_POLLOUT;
+
+	return events;
+}
+
+/**
+ * @brief A whole frame of the CID is parked
+ */
+bool TelitWiFi::parked(char cid)
+{
+	TWIFI_Parked rec;
+	uint16_t end = mParkOpen ? mParkFrame : mParkLen;
+
+	for( uint16_t pos = 0; pos < end; pos += sizeof(rec) + rec.length ){
+		memcpy( &rec, mPark + pos, sizeof(rec) );
+		if( rec.cid == cid )
+			return true;
+	}
+	return false;
+}
+
+/**
+ * @brief Take the oldest parked frame of the CID
+ * @param char cid: Channel ID
+ *        bool udp - IN: <ESC>y frames, else <ESC>Z
+ *        uint8_t *data - OUT: data, the rest of a longer frame is lost
+ *        ATCMD_IPv4 ip, uint16_t *port - OUT: source of <ESC>y, NULL if not needed
+ * @return size of data, -1 if none
+ */
+int TelitWiFi::park_take(char cid, bool udp, uint8_t* data, int length, ATCMD_IPv4 ip, uint16_t* port)
+{
+	TWIFI_Parked rec;
+	uint16_t end = mParkOpen ? mParkFrame : mParkLen;
+	uint16_t size;
+
+	for( uint16_t pos = 0; pos < end; pos += size ){
+		memcpy( &rec, mPark + pos, sizeof(rec) );
+		size = sizeof(rec) + rec.length;
+		if( rec.cid != cid || rec.udp != udp )
+			continue;
+
+		if( length > rec.length )
+			length = rec.length;
+		else if( length < rec.length )
+			ConsoleLog( "Lost some data.");
+		memcpy( data, mPark + pos + sizeof(rec), length );
+		if( ip )
+			memcpy( ip, rec.ip, sizeof(ATCMD_IPv4) );
+		if( port )
+			*port = rec.port;
+
+		memmove( mPark + pos, mPark + pos + size, mParkLen - pos - size );
+		mParkLen -= size;
+		if( mParkOpen )
+			mParkFrame -= size;
+		mParkCount--;
+		return length;
+	}
+	return -1;
+}
+
+/**
+ * @brief Data of a CID without a socket, len is 0 at the end of a frame
+ *        pump() reads only when a frame fits, one read outside it may not
+ */
+void TelitWiFi::park_receive(char cid, const uint8_t* data, uint16_t length, bool source)
+{
+	TWIFI_Parked rec;
+
+	if( mParkDiscard ){
+		if( !length )
+			mParkDiscard = false;
+		return;
+	}
+
+	if( !mPark ){
+		if( length ){
+			gs2200_printf( "No park, frame of CID %c lost\n", cid );
+			mParkDiscard = true;
+		}
+		return;
+	}
+
+	if( !mParkOpen ){
+		if( !length )
+			return;
+		/* Room for the header, written at the end */
+		if( (size_t)( TWIFI_PARK_SIZE - mParkLen ) < sizeof(rec) ){
+			gs2200_printf( "Park full, frame of CID %c lost\n", cid );
+			mParkDiscard = true;
+			return;
+		}
+		mParkFrame = mParkLen;
+		mParkLen += sizeof(rec);
+		mParkOpen = true;
+	}
+
+	if( length ){
+		if( length > TWIFI_PARK_SIZE - mParkLen ){
+			gs2200_printf( "Park full, frame of CID %c lost\n", cid );
+			mParkLen = mParkFrame;
+			mParkOpen = false;
+			mParkDiscard = true;
+			return;
+		}
+		memcpy( mPark + mParkLen, data, length );
+		mParkLen += length;
+		return;
+	}
+
+	rec.cid = cid;
+	rec.udp = source;
+	rec.length = mParkLen - mParkFrame - sizeof(rec);
+	if( source ){
+		AtCmd_GetUDPSource( rec.ip, &rec.port );
+	}else{
+		memset( rec.ip, 0, sizeof(rec.ip) );
+		rec.port = 0;
+	}
+	memcpy( mPark + mParkFrame, &rec, sizeof(rec) );
+	mParkOpen = false;
+	mParkCount++;
+}
+
+/**
+ * @brief Data of an attached CID, len is 0 at the end of a frame
+ *        TCP fits when pump() reads it, it reads only then. A datagram
+ *        that does not fit in the ring is dropped as a whole.
+ */
+void TelitWiFi::socket_receive(char cid, const uint8_t* data, uint16_t length, bool source)
+{
+	TWIFI_Socket* sock = find_socket( cid );
+	TWIFI_Datagram dg;
+
+	if( !sock ){
+		park_receive( cid, data, length, source );
+		return;
+	}
+
+	if( !sock->udp ){
+		if( length > TWIFI_SOCKET_RX_SIZE - sock->rxLen ){
+			/* Read by the response wait of an AT command, pump() never gets here */
+			sock->dropped += length - ( TWIFI_SOCKET_RX_SIZE - sock->rxLen );
+			length = TWIFI_SOCKET_RX_SIZE - sock->rxLen;
+		}
+		ring_put( sock, sock->rxLen, data, length );
+		sock->rxLen += length;
+		if( length )
+			first_packet();
+		return;
+	}
+
+	if( sock->rxDiscard ){
+		/* The rest of a datagram that did not fit */
+		sock->dropped += length;
+		if( !length )
+			sock->rxDiscard = false;
+		return;
+	}
+
+	if( !sock->rxOpen ){
+		if( !length )
+			return;
+		/* Room for the header, written at the end */
+		if( (size_t)( TWIFI_SOCKET_RX_SIZE - sock->rxLen ) < sizeof(dg) ){
+			sock->dropped += length;
+			sock->rxDiscard = true;
+			return;
+		}
+		sock->rxFrame = sock->rxLen;
+		sock->rxLen += sizeof(dg);
+		sock->rxOpen = true;
+	}
+
+	if( length ){
+		if( length > TWIFI_SOCKET_RX_SIZE - sock->rxLen ){
+			/* Does not fit, forget what we have of it and what still comes */
+			sock->dropped += length + sock->rxLen - sock->rxFrame - sizeof(dg);
+			sock->rxLen = sock->rxFrame;
+			sock->rxOpen = false;
+			sock->rxDiscard = true;
+			return;
+		}
+		ring_put( sock, sock->rxLen, data, length );
+		sock->rxLen += length;
+		return;
+	}
+
+	dg.length = sock->rxLen - sock->rxFrame - sizeof(dg);
+	if( source ){
+		AtCmd_GetUDPSource( dg.ip, &dg.port );
+	}else{
+		memset( dg.ip, 0, sizeof(dg.ip) );
+		dg.port = 0;
+	}
+	ring_put( sock, sock->rxFrame, &dg, sizeof(dg) );
+	sock->rxOpen = false;
+	first_packet();
+}
+
+void TelitWiFi::on_bulk(char cid, const uint8_t* data, uint16_t length, void* arg)
+{
+	((TelitWiFi*)arg)->socket_receive( cid, data, length, false );
+}
+
+void TelitWiFi::on_udp(char cid, const uint8_t* data, uint16_t length, void* arg)
+{
+	((TelitWiFi*)arg)->socket_receive( cid, data, length, true );
 }
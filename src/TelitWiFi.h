@@ -27,6 +27,213 @@ typedef struct {
 	ATCMD_PSAVE_E psave;
 } TWIFI_Params;
 
+#define TWIFI_LINK_CHECK     30000 /* ms between AT+NSTAT checks while the link is up */
+#define TWIFI_BACKOFF_MIN    1000  /* ms before the first reassociation */
+#define TWIFI_BACKOFF_MAX    60000 /* the wait doubles up to this */
+#define TWIFI_REOPEN_NUM     4     /* sockets reopened by the supervisor */
+#define TWIFI_HOST_SIZE      64
+
+typedef enum {
+	TWIFI_LINK_OFF = 0,   /* not supervised */
+	TWIFI_LINK_UP,
+	TWIFI_LINK_LOST       /* reassociating */
+} TWIFI_LinkState;
+
+typedef enum {
+	TWIFI_TCP_CLIENT = 0,
+	TWIFI_UDP_CLIENT,
+	TWIFI_TCP_SERVER,
+	TWIFI_UDP_SERVER
+} TWIFI_SocketType;
+
+typedef struct {
+	uint32_t outages;     /* link losses noticed */
+	uint32_t attempts;    /* reassociations tried */
+	uint32_t lastOutage;  /* ms from the loss to the recovery, last outage */
+	uint32_t lastRecovery;/* ms of the reassociation that succeeded and the reopening */
+	uint32_t maxOutage;
+	uint32_t totalOutage;
+	uint8_t  reopened;    /* sockets reopened after the last outage */
+	uint8_t  reopenFailed;/* sockets not reopened yet, supervise() tries them again */
+} TWIFI_LinkStats;
+
+typedef struct {
+	bool     used;        /* false: free */
+	bool     closed;      /* lost with the link and not reopened yet */
+	char     cid;         /* open now, ATCMD_INVALID_CID while closed */
+	char     lost;        /* CID before the outage, oldCid of the handler */
+	uint32_t retry;       /* millis() of the last failed reopening */
+	uint32_t backoff;     /* ms to the next one, doubles on each failure */
+	TWIFI_SocketType type;
+	char     host[TWIFI_HOST_SIZE];
+	char     port[6];
+	char     local[6];    /* source port of UDP client */
+	/* The socket of the CID when the link was lost, attached again on reopening */
+	bool     attached;
+	bool     udp;
+	char     server;
+	bool     coalesce;
+} TWIFI_Reopen;
+
+/* A socket was reopened after an outage, newCid is ATCMD_INVALID_CID on the
+   first failure, the handler is called again when a later try succeeds */
+typedef void (*TWIFI_ReopenHandler)(char oldCid, char newCid, void *arg);
+
+#define TWIFI_LISTENER_NUM   4     /* event handlers at a time */
+
+/* ATCMD_RESP_DISCONNECT of cid or ATCMD_RESP_DISASSOCIATION_EVENT read by pump() */
+typedef void (*TWIFI_EventHandler)(ATCMD_RESP_E event, char cid, void *arg);
+
+typedef struct {
+	TWIFI_EventHandler handler;
+	void*    arg;
+} TWIFI_Listener;
+
+#define TWIFI_BOOT_STEP_NUM  15    /* steps of begin() */
+#define TWIFI_BOOT_RETRY     3     /* tries of an optional step, others retry till timeout */
+#define TWIFI_PROFILE_SIZE   512   /* active profile read by AT&V */
+
+typedef struct {
+	const char* name;     /* command */
+	uint16_t ms;          /* time spent, retries included */
+	uint16_t tries;       /* 0: skipped */
+} TWIFI_BootStep;
+
+typedef struct {
+	TWIFI_BootStep step[TWIFI_BOOT_STEP_NUM];
+	uint32_t total;       /* ms of begin() */
+	bool     verified;    /* the stored profile had the configuration */
+	bool     saved;       /* the configuration was saved in the profile */
+} TWIFI_BootReport;
+
+#define TWIFI_RECV_TIMEOUT   10000 /* wait for a datagram for this period */
+#define TWIFI_STREAM_TIMEOUT 10000 /* give up when no frame is accepted for this period */
+
+/* Fill buf up to size bytes. Return the number of bytes, 0 at the end, negative on error */
+typedef int (*TWIFI_Producer)(uint8_t *buf, uint16_t size, void *arg);
+
+typedef struct {
+	uint32_t bytes;       /* bytes delivered to GS2200 */
+	uint32_t frames;      /* <ESC>Z frames delivered */
+	uint32_t retries;     /* frames sent again after an error */
+	uint32_t elapsed;     /* milliseconds */
+	uint32_t throughput;  /* bytes per second */
+} TWIFI_TxStats;
+
+#define TWIFI_FLOW_PROBE     2     /* ms between tries while GS2200 has no room */
+#define TWIFI_FLOW_HEADER    7     /* <ESC>Z<cid><4 digits> in front of the data */
+
+typedef struct {
+	uint32_t frames;      /* frames GS2200 took */
+	uint32_t refused;     /* tries GS2200 had no room for */
+	uint32_t stalls;      /* times the CID had to wait for room */
+	uint32_t stallTime;   /* ms waited in all */
+	uint32_t maxStall;    /* longest wait */
+	uint32_t stalled;     /* ms the CID is waiting now, 0 if it is not */
+	uint16_t credit;      /* bytes GS2200 could take at the last refusal */
+	uint16_t backlog;     /* bytes buffered for the CID, not given to GS2200 yet */
+} TWIFI_FlowStats;
+
+typedef struct {
+	TWIFI_FlowStats stats;
+	bool     stalled;
+	uint32_t since;       /* millis() of the first refusal */
+	uint32_t probe;       /* millis() of the last try */
+} TWIFI_Flow;
+
+#define TWIFI_BATCH_SIZE     1500  /* datagrams packed into one SPI write */
+
+typedef struct {
+	uint32_t datagrams;   /* datagrams delivered to GS2200 */
+	uint32_t writes;      /* SPI writes used for them */
+	uint32_t dropped;     /* datagrams dropped on error */
+	uint32_t elapsed;     /* milliseconds from the first datagram to the last flush */
+	uint32_t rate;        /* datagrams per second */
+} TWIFI_BatchStats;
+
+typedef enum {
+	TWIFI_SOCKPROF_DEFAULT = 0,  /* firmware defaults, no AT+NXSETSOCKOPT */
+	TWIFI_SOCKPROF_BULK,         /* large receive buffer, deep TX queue */
+	TWIFI_SOCKPROF_LOW_LATENCY,  /* short retransmit timer, expedited DSCP */
+	TWIFI_SOCKPROF_KEEPALIVE     /* TCP keepalive for long idle connections */
+} TWIFI_SocketProfile;
+
+#define TWIFI_SOCKET_NUM      6     /* sockets buffered at a time, listening ones included */
+#define TWIFI_SOCKET_RX_SIZE  4096  /* receive ring of a socket, pump() needs MAX_RECEIVED_DATA free in TCP ones */
+#define TWIFI_ACCEPT_NUM      TWIFI_SOCKET_NUM  /* connections accepted but not taken yet */
+
+/* Events of poll() */
+#define TWIFI_POLLIN   0x01   /* data or a datagram to read, or a connection to accept */
+#define TWIFI_POLLOUT  0x02   /* write() can take data */
+#define TWIFI_POLLHUP  0x04   /* closed by the peer, reported without asking */
+
+typedef struct {
+	char    cid;
+	uint8_t events;       /* TWIFI_POLL* wanted */
+	uint8_t revents;      /* TWIFI_POLL* ready, set by poll() */
+} TWIFI_PollFd;
+
+typedef struct {
+	uint32_t accepted;    /* connections attached to a socket */
+	uint32_t refused;     /* connections closed, no free socket or queue full */
+	uint8_t  pending;     /* in the queue now */
+	uint8_t  peak;        /* most in the queue at a time */
+} TWIFI_AcceptStats;
+
+#define TWIFI_PARK_SIZE       8192  /* frames of CIDs without a socket, kept for read()/recvfrom() */
+
+/* Frame of a CID without a socket parked by pump(), the data follows */
+typedef struct {
+	char       cid;
+	bool       udp;       /* <ESC>y, with its source */
+	uint16_t   length;
+	ATCMD_IPv4 ip;
+	uint16_t   port;
+} TWIFI_Parked;
+
+/* Datagram header in the ring of a UDP socket, the data follows */
+typedef struct {
+	uint16_t   length;
+	ATCMD_IPv4 ip;
+	uint16_t   port;
+} TWIFI_Datagram;
+
+typedef struct {
+	char     cid;         /* ATCMD_INVALID_CID: free */
+	char     server;      /* listening CID it was accepted on, ATCMD_INVALID_CID if none */
+	bool     udp;         /* datagrams are kept with their source */
+	bool     closed;      /* DISCONNECT received, buffered data can still be read */
+	uint8_t* rx;          /* TWIFI_SOCKET_RX_SIZE bytes, allocated by the first socket_attach() of the slot */
+	uint16_t rxHead;
+	uint16_t rxLen;
+	uint16_t rxFrame;     /* rxLen at the start of the datagram being received */
+	bool     rxOpen;      /* a datagram is being received */
+	bool     rxDiscard;   /* the rest of the datagram being received is dropped */
+	uint32_t dropped;     /* bytes lost because the ring was full, TCP only if an AT command read them */
+} TWIFI_Socket;
+
+#define TWIFI_COALESCE_NUM    TWIFI_SOCKET_NUM  /* CIDs with small writes pending at a time */
+#define TWIFI_COALESCE_DELAY  20    /* ms the first small write may wait for more */
+
+typedef struct {
+	uint32_t writes;      /* writes taken into the buffers */
+	uint32_t frames;      /* <ESC>Z frames sent for them */
+	uint32_t saved;       /* frames not needed because writes were merged */
+	uint32_t threshold;   /* flushes because the buffer was full enough */
+	uint32_t timer;       /* flushes because the first write waited too long */
+	uint32_t request;     /* flush(), or before a stream, stop or close */
+	uint32_t evicted;     /* flushes to free a buffer for another CID */
+	uint32_t dropped;     /* buffers given up because the CID was closed or coalescing stopped */
+} TWIFI_CoalesceStats;
+
+typedef struct {
+	char     cid;         /* ATCMD_INVALID_CID: free */
+	uint8_t* data;        /* ATCMD_BULK_MAX_SIZE bytes, allocated when the slot is first used */
+	uint16_t length;
+	uint16_t writes;      /* writes merged into data */
+	uint32_t oldest;      /* millis() of the first of them */
+} TWIFI_TxBuffer;
+
 
 /**
  * @class TelitWiFi
@@ -53,12 +260,52 @@ public:
 	 */
 	int begin(TWIFI_Params params);
 
+	/**
+	 *  Boot profile: begin() saves the configuration in profile 0 of the
+	 *  module and checks it with AT&V on the next boot, only settings that
+	 *  differ are sent again
+	 */
+	void set_boot_profile(bool enable);
+	void get_boot_report(TWIFI_BootReport* report);
+	void print_boot_report();
+
 	/**
 	 *  AP association (station mode), AP creation (Limited-AP mode)
 	 */
 	int activate_station(const String& ssid, const String& passphrase);
 	int activate_ap(const String& ssid, const String& passphrase, uint8_t channel);
 
+	/**
+	 *  Fast resume: store the network context after association and try
+	 *  AT+RESTORENWCONN before a full association on the next boot/wake-up
+	 */
+	void set_fast_resume(bool enable);
+	int resume_station(const String& ssid, const String& passphrase);
+	bool resumed();
+
+	/**
+	 *  Milliseconds from begin() to the first packet sent/received, 0 if none yet
+	 */
+	uint32_t time_to_first_packet();
+
+	/**
+	 *  Link supervisor in Station mode: supervise() from the loop (poll()
+	 *  calls it) notices the loss of the link, reassociates with exponential
+	 *  backoff and reopens the registered sockets, one AT command per call
+	 */
+	void set_supervisor(bool enable, TWIFI_ReopenHandler handler = NULL, void *arg = NULL);
+	bool supervise_socket(char cid, TWIFI_SocketType type, const char *host, const char *port, const char *local = NULL);
+	void unsupervise_socket(char cid);
+	TWIFI_LinkState supervise();
+	TWIFI_LinkState link_state() { return mLinkState; }
+	void get_link_stats(TWIFI_LinkStats* stats);
+
+	/**
+	 * Socket option profile applied right after connect/accept
+	 */
+	void set_socket_profile(TWIFI_SocketProfile profile);
+	bool apply_socket_profile(char cid, TWIFI_SocketProfile profile, bool tcp = true);
+
 	/**
 	 * Connect TCP server
 	 */
@@ -78,6 +325,21 @@ public:
 	 * Connect UDP server
 	 */
 	char connectUDP(const String& ip, const String& port, const String& srcPort);
+
+	/**
+	 * Start UDP server
+	 */
+	char start_udp_server(char* port);
+
+	/**
+	 * Receive a datagram with its source address (UDP server)
+	 */
+	int recvfrom(char cid, uint8_t* data, int length, ATCMD_IPv4 ip, uint16_t* port, uint32_t timeout = TWIFI_RECV_TIMEOUT);
+
+	/**
+	 * Send a datagram to a binary address (UDP server)
+	 */
+	bool sendto(char cid, const uint8_t* data, uint16_t length, const ATCMD_IPv4 ip, uint16_t port);
 	/**
 	 * Connect TCP server
 	 */
@@ -88,11 +350,100 @@ public:
 	 */
 	void stop(char cid);
 
+	/**
+	 * Close the connection at once, without waiting for the server like stop()
+	 */
+	void close(char cid);
+
 	/**
 	 * Send data to TCP server
 	 */
 	bool write(char cid, const uint8_t* data, uint16_t length);
 
+	/**
+	 * TX flow control: GS2200 reports the room it has when it refuses a
+	 * frame, a CID is stalled from then until a frame is taken again.
+	 * writable() tells if a write of length bytes is worth trying now,
+	 * write_until() waits for room until the deadline (ms from now) and
+	 * sizes the frames by the room reported. write_frames() gives frames
+	 * built by the caller in one SPI write, counted for the CID.
+	 */
+	bool writable(char cid, uint16_t length = 1);
+	size_t write_until(char cid, const uint8_t* data, size_t length, uint32_t deadline);
+	bool write_frames(char cid, const uint8_t* frames, uint16_t size, uint32_t timeout);
+	void get_flow_stats(char cid, TWIFI_FlowStats* stats);
+	void reset_flow_stats();
+
+	/**
+	 * Coalescing of small writes on TCP CIDs: write() collects the data
+	 * until the threshold, flush() or the delay after the first write.
+	 * The delay is checked by write(), available() and pump(), they try
+	 * once and do not wait. A frame GS2200 does not take stays buffered,
+	 * write() takes no more once it is full and flush() returns false.
+	 */
+	void set_coalesce(char cid, bool enable);
+	void set_coalesce_timing(uint16_t threshold, uint32_t delay);
+	bool flush(char cid);
+	bool flush();
+	void coalesce_poll();
+	void get_coalesce_stats(TWIFI_CoalesceStats* stats);
+	void reset_coalesce_stats();
+
+	/**
+	 * Send data of any size split into <ESC>Z frames
+	 * Return the number of bytes delivered
+	 */
+	size_t write_stream(char cid, const uint8_t* data, size_t length, uint32_t timeout = TWIFI_STREAM_TIMEOUT);
+	size_t write_stream(char cid, TWIFI_Producer producer, void* arg, uint32_t timeout = TWIFI_STREAM_TIMEOUT);
+
+	/**
+	 * Statistics of the last write_stream
+	 */
+	void get_tx_stats(TWIFI_TxStats* stats);
+
+	/**
+	 * Batched UDP transmit: queue datagrams and send them in one SPI write
+	 */
+	bool batch_add(char cid, const uint8_t* data, uint16_t length);
+	bool batch_add_to(char cid, const uint8_t* data, uint16_t length, const ATCMD_IPv4 ip, uint16_t port);
+	bool batch_flush();
+	bool batch_poll();
+	void set_batch_deadline(uint32_t ms);
+	void get_batch_stats(TWIFI_BatchStats* stats);
+	void reset_batch_stats();
+
+	/**
+	 * Buffered sockets: pump() receives the data of every attached CID into
+	 * its own ring, small writes are collected into full <ESC>Z frames
+	 */
+	bool socket_attach(char cid, bool udp = false, char server = ATCMD_INVALID_CID);
+	void socket_close(char cid);
+	int socket_available(char cid);
+	int socket_read(char cid, uint8_t* data, int length);
+	int socket_peek(char cid);
+	int socket_recvfrom(char cid, uint8_t* data, int length, ATCMD_IPv4 ip, uint16_t* port);
+	size_t socket_write(char cid, const uint8_t* data, size_t length);
+	bool socket_flush(char cid);
+	bool socket_closed(char cid);
+	uint32_t socket_dropped(char cid);
+	char socket_accepted(char server, char after = ATCMD_INVALID_CID);
+	char socket_accept(char server, char cid = ATCMD_INVALID_CID);
+	void get_accept_stats(TWIFI_AcceptStats* stats);
+	void pump();
+
+	/**
+	 * Events read by pump() for the users of CIDs without a socket
+	 * (MqttGs2200, HttpGs2200), they call pump() instead of reading GS2200
+	 */
+	bool add_event_handler(TWIFI_EventHandler handler, void *arg);
+	void remove_event_handler(TWIFI_EventHandler handler, void *arg);
+
+	/**
+	 * Wait until one of the CIDs is ready, like poll() of POSIX
+	 * Return the number of CIDs with revents set, 0 on timeout
+	 */
+	int poll(TWIFI_PollFd* fds, uint8_t count, uint32_t timeout);
+
 	/**
 	 *  Available TCP read
 	 */
@@ -103,6 +454,103 @@ public:
 	 */
 	int read(char cid, uint8_t* data, int length);
 
+private:
+
+	void first_packet();
+	void link_lost();
+	int link_recover();
+	char reopen(TWIFI_Reopen* entry);
+	void reopen_entry(TWIFI_Reopen* entry);
+	bool reopen_retry();
+	bool boot_needed(uint8_t step, const TWIFI_Params& params, bool save);
+	int boot_check(uint8_t step, const TWIFI_Params& params);
+	ATCMD_RESP_E boot_command(uint8_t step, const TWIFI_Params& params);
+	uint16_t send_frame(char cid, const uint8_t* data, uint16_t length, uint32_t timeout);
+	bool send_bulk(char cid, const uint8_t* data, uint16_t length);
+	bool wait_writable(char cid, uint32_t start, uint32_t timeout);
+	bool flow_ready(char cid, uint16_t length);
+	uint16_t flow_size(char cid, uint16_t length);
+	bool flow_result(char cid, bool sent);
+	void stream_done(uint32_t start);
+	bool batch_reserve(uint16_t size);
+	TWIFI_Socket* find_socket(char cid);
+	bool rx_room();
+	void accept_add(char cid, char server);
+	void accept_remove(char cid);
+	void accept_clear();
+	uint8_t poll_events(char cid);
+	void notify(ATCMD_RESP_E event, char cid);
+	void socket_receive(char cid, const uint8_t* data, uint16_t length, bool source);
+	void park_receive(char cid, const uint8_t* data, uint16_t length, bool source);
+	int park_take(char cid, bool udp, uint8_t* data, int length, ATCMD_IPv4 ip, uint16_t* port);
+	bool parked(char cid);
+	static void on_bulk(char cid, const uint8_t* data, uint16_t length, void* arg);
+	static void on_udp(char cid, const uint8_t* data, uint16_t length, void* arg);
+	size_t coalesce(char cid, const uint8_t* data, size_t length);
+	TWIFI_TxBuffer* find_tx_buffer(char cid);
+	TWIFI_TxBuffer* coalesce_buffer(char cid);
+	bool coalesce_flush(TWIFI_TxBuffer* buf, uint32_t* reason, uint32_t timeout);
+	void coalesce_drop(char cid);
+
+	TWIFI_SocketProfile mSockProfile;
+	TWIFI_TxStats       mTxStats;
+
+	uint8_t* mBatch;             /* TWIFI_BATCH_SIZE bytes, allocated for the first datagram */
+	uint16_t mBatchLen;
+	uint16_t mBatchCount;
+	uint32_t mBatchOldest;
+	uint32_t mBatchDeadline;
+	uint32_t mBatchStart;
+	char     mBatchCid;           /* CID of the first datagram, refusals are counted for it */
+	TWIFI_BatchStats    mBatchStats;
+
+	bool     mFastResume;
+	bool     mResumed;
+	uint32_t mBootStart;
+	bool     mBootProfile;
+	TWIFI_BootReport mBootReport;
+	uint32_t mFirstPacket;
+
+	TWIFI_Socket mSockets[TWIFI_SOCKET_NUM];
+
+	/* Accepted connections in the order they came */
+	char     mAcceptCid[TWIFI_ACCEPT_NUM];
+	char     mAcceptServer[TWIFI_ACCEPT_NUM];
+	TWIFI_AcceptStats mAcceptStats;
+
+	/* Link supervisor */
+	TWIFI_LinkState mLinkState;
+	TWIFI_LinkStats mLinkStats;
+	TWIFI_ReopenHandler mReopenHandler;
+	void*    mReopenArg;
+	TWIFI_Reopen mReopen[TWIFI_REOPEN_NUM];
+	char     mSsid[ATCMD_SSID_MAX_LENGTH + 1];
+	char     mPassphrase[ATCMD_PASSWORD_MAX_LENGTH + 1];
+	uint32_t mLinkCheck;       /* millis() of the last check or attempt */
+	uint32_t mLinkLost;        /* millis() of the loss */
+	uint32_t mBackoff;
+	bool     mLinkCheckDue;
+	uint8_t  mRecoverStep;     /* next command of the reassociation */
+	uint8_t  mRecoverNext;     /* next mReopen entry to open */
+	uint32_t mRecoverStart;    /* millis() of the first command of the attempt */
+
+	TWIFI_Listener mListeners[TWIFI_LISTENER_NUM];
+
+	/* Frames of CIDs without a socket read by pump(), in the order they came */
+	uint8_t* mPark;            /* TWIFI_PARK_SIZE bytes, allocated by the first pump() */
+	uint16_t mParkLen;
+	uint16_t mParkFrame;       /* offset of the frame being received */
+	uint16_t mParkCount;       /* whole frames */
+	bool     mParkOpen;        /* a frame is being received */
+	bool     mParkDiscard;     /* the rest of the frame being received is dropped */
+
+	uint16_t mCoalesceCids;       /* bit per CID */
+	uint16_t mCoalesceThreshold;
+	uint32_t mCoalesceDelay;
+	TWIFI_TxBuffer mTxBuffers[TWIFI_COALESCE_NUM];
+	TWIFI_CoalesceStats mCoalesceStats;
+	TWIFI_Flow mFlow[ATCMD_MAX_CID];
+
 };
 
 #endif /*_TELITWIFI_H_*/